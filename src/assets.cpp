@@ -1,13 +1,15 @@
 #include <cstdint>
 #include <filesystem>
-#include <iostream>
+#include <optional>
 #include <string>
 #include <string_view>
 #include <unordered_map>
 #include <variant>
+#include <vector>
 
 #include "SDL3/SDL_gpu.h"
 #include "SDL3_image/SDL_image.h"
+#include "gatherer.hpp"
 namespace fs = std::filesystem;
 
 constexpr std::string_view ASSETS = "resources/";
@@ -32,6 +34,11 @@ enum class AssetType : uint8_t {
 };
 
 using AssetVariant = std::variant<Texture>;
+using AssetCache = std::unordered_map<
+    std::string, AssetVariant, std::hash<std::string>,
+    std::equal_to<std::string>,
+    TrackingAllocator<std::pair<const std::string, AssetVariant>,
+                      MemoryTag::Assets>>;
 
 struct AssetHeader {
   AssetType type;
@@ -40,9 +47,10 @@ struct AssetHeader {
   uint32_t size;
 };
 
-class AssetManager {
+class AssetManager : public TrackedObject<MemoryTag::Assets> {
 public:
-  AssetManager() : cache(std::unordered_map<std::string, AssetVariant>{}) {}
+  AssetManager(ThreadPool *pool)
+      : cache(AssetCache{}), pool(pool) {}
   ~AssetManager() {} // TODO unload assets
 
   void load_asset(SDL_GPUDevice *device, const std::string &name,
@@ -52,77 +60,105 @@ public:
 #else
     switch (type) {
     case AssetType::Texture: {
-      auto texture = Texture{};
-      fs::path directory = fs::path(ASSETS) / "textures/";
-      for (const auto &file : fs::directory_iterator(directory)) {
-        auto file_stem = file.path().stem().string();
-        if (file_stem == name) {
-          std::cout << "Found File: " << file.path() << std::endl;
-          auto image =
-              IMG_Load(reinterpret_cast<const char *>(file.path().c_str()));
-          if (image == NULL) {
-            SDL_LogError(0, "Unable to load image %s",
-                         reinterpret_cast<const char *>(file.path().c_str()));
-          }
-
-          texture.width = image->w;
-          texture.height = image->h;
-
-          const auto transfer_buffer_create_info =
-              SDL_GPUTransferBufferCreateInfo{
-                  .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
-                  .size = static_cast<Uint32>(image->w * image->h * 4)};
-          auto texture_transfer_buffer =
-              SDL_CreateGPUTransferBuffer(device, &transfer_buffer_create_info);
-          auto texture_transfer_ptr =
-              SDL_MapGPUTransferBuffer(device, texture_transfer_buffer, false);
-          SDL_memcpy(texture_transfer_ptr, image->pixels,
-                     image->w * image->h * 4);
-          SDL_UnmapGPUTransferBuffer(device, texture_transfer_buffer);
-
-          const auto texture_create_info = SDL_GPUTextureCreateInfo{
-              .type = SDL_GPU_TEXTURETYPE_2D,
-              .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
-              .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
-              .width = static_cast<Uint32>(image->w),
-              .height = static_cast<Uint32>(image->h),
-              .layer_count_or_depth = 1,
-              .num_levels = 1};
-
-          texture.handle = SDL_CreateGPUTexture(device, &texture_create_info);
-
-          auto upload_cmd_buffer = SDL_AcquireGPUCommandBuffer(device);
-          auto copy_pass = SDL_BeginGPUCopyPass(upload_cmd_buffer);
-
-          auto texture_transfer_info = SDL_GPUTextureTransferInfo{
-              .transfer_buffer = texture_transfer_buffer,
-              .offset = 0,
-          };
-
-          auto texture_region =
-              SDL_GPUTextureRegion{.texture = texture.handle,
-                                   .w = static_cast<Uint32>(image->w),
-                                   .h = static_cast<Uint32>(image->h),
-                                   .d = 1};
-
-          SDL_UploadToGPUTexture(copy_pass, &texture_transfer_info,
-                                 &texture_region, false);
-
-          SDL_EndGPUCopyPass(copy_pass);
-          SDL_SubmitGPUCommandBuffer(upload_cmd_buffer);
-
-          SDL_DestroySurface(image);
-          SDL_ReleaseGPUTransferBuffer(device, texture_transfer_buffer);
-          cache[name] = texture;
-          return;
-        }
+      auto path = find_texture(name);
+      if (!path.has_value()) {
+        log_message<LogLevel::Warn>(SDL_LOG_CATEGORY_APPLICATION,
+                                    "No texture found with the name %s",
+                                    name.c_str());
+        return;
       }
-      std::cout << "No texture found with the name " << name << std::endl;
+      auto image = IMG_Load(reinterpret_cast<const char *>(path->c_str()));
+      if (image == NULL) {
+        log_message<LogLevel::Error>(
+            SDL_LOG_CATEGORY_APPLICATION, "Unable to load image %s",
+            reinterpret_cast<const char *>(path->c_str()));
+        return;
+      }
+      load_texture(device, name, image);
+      SDL_DestroySurface(image);
     }
     }
 #endif
   }
 
+  std::optional<fs::path> find_texture(const std::string &name) const {
+    fs::path directory = fs::path(ASSETS) / "textures/";
+    for (const auto &file : fs::directory_iterator(directory)) {
+      if (file.path().stem().string() == name) {
+        log_message<LogLevel::Debug>(
+            SDL_LOG_CATEGORY_APPLICATION, "Found File: %s",
+            reinterpret_cast<const char *>(file.path().c_str()));
+        return file.path();
+      }
+    }
+    return std::nullopt;
+  }
+
+  // Processes a decoded image and uploads it with its full mip chain.
+  void load_texture(SDL_GPUDevice *device, const std::string &name,
+                    SDL_Surface *image) {
+    auto texture = Texture{};
+    auto processed = process_texture(pool, image, TextureProcessOptions{});
+    if (!processed.has_value()) {
+      log_message<LogLevel::Error>(SDL_LOG_CATEGORY_APPLICATION,
+                                   "Unable to process image %s: %s",
+                                   name.c_str(), processed.error().c_str());
+      return;
+    }
+
+    texture.width = static_cast<int>(processed->width);
+    texture.height = static_cast<int>(processed->height);
+
+    const auto transfer_buffer_create_info = SDL_GPUTransferBufferCreateInfo{
+        .usage = SDL_GPU_TRANSFERBUFFERUSAGE_UPLOAD,
+        .size = static_cast<Uint32>(processed->pixels.size())};
+    auto texture_transfer_buffer =
+        SDL_CreateGPUTransferBuffer(device, &transfer_buffer_create_info);
+    auto texture_transfer_ptr =
+        SDL_MapGPUTransferBuffer(device, texture_transfer_buffer, false);
+    SDL_memcpy(texture_transfer_ptr, processed->pixels.data(),
+               processed->pixels.size());
+    SDL_UnmapGPUTransferBuffer(device, texture_transfer_buffer);
+
+    const auto texture_create_info = SDL_GPUTextureCreateInfo{
+        .type = SDL_GPU_TEXTURETYPE_2D,
+        .format = SDL_GPU_TEXTUREFORMAT_R8G8B8A8_UNORM,
+        .usage = SDL_GPU_TEXTUREUSAGE_SAMPLER,
+        .width = processed->width,
+        .height = processed->height,
+        .layer_count_or_depth = 1,
+        .num_levels = static_cast<Uint32>(processed->levels.size())};
+
+    texture.handle = SDL_CreateGPUTexture(device, &texture_create_info);
+
+    auto upload_cmd_buffer = SDL_AcquireGPUCommandBuffer(device);
+    auto copy_pass = SDL_BeginGPUCopyPass(upload_cmd_buffer);
+
+    for (size_t level = 0; level < processed->levels.size(); level++) {
+      const auto &mip = processed->levels[level];
+      auto texture_transfer_info = SDL_GPUTextureTransferInfo{
+          .transfer_buffer = texture_transfer_buffer,
+          .offset = static_cast<Uint32>(mip.offset),
+      };
+
+      auto texture_region =
+          SDL_GPUTextureRegion{.texture = texture.handle,
+                               .mip_level = static_cast<Uint32>(level),
+                               .w = mip.width,
+                               .h = mip.height,
+                               .d = 1};
+
+      SDL_UploadToGPUTexture(copy_pass, &texture_transfer_info,
+                             &texture_region, false);
+    }
+
+    SDL_EndGPUCopyPass(copy_pass);
+    SDL_SubmitGPUCommandBuffer(upload_cmd_buffer);
+
+    SDL_ReleaseGPUTransferBuffer(device, texture_transfer_buffer);
+    cache[name] = texture;
+  }
+
   void unload_asset(SDL_GPUDevice *device, const std::string &name) {
     auto node = cache.extract(name);
     if (!node.empty()) {
@@ -160,6 +196,57 @@ public:
   }
 
 private:
-  std::unordered_map<std::string, AssetVariant> cache;
+  AssetCache cache;
+  ThreadPool *pool;
 };
+
+// Reads every named texture in one I/O batch, decodes them in parallel on
+// the pool and then uploads them one at a time, since the AssetManager and
+// the GPU device are not shared between threads.
+Task<void> preload_textures(Context *ctx, std::vector<std::string> names) {
+  std::vector<std::string> found;
+  std::vector<std::string> paths;
+  for (const auto &name : names) {
+    if (auto path = ctx->asset_manager->find_texture(name)) {
+      found.push_back(name);
+      paths.push_back(path->string());
+    } else {
+      log_message<LogLevel::Warn>(SDL_LOG_CATEGORY_APPLICATION,
+                                  "No texture found with the name %s",
+                                  name.c_str());
+    }
+  }
+
+  auto files = co_await read_files(ctx, paths);
+
+  // SDL errors are per thread, so decode failures are recorded where they
+  // happen.
+  std::vector<SDL_Surface *> images(files.size(), nullptr);
+  std::vector<std::string> errors(files.size());
+  parallel_for(ctx->pool, files.size(), [&](size_t i) {
+    if (!files[i].has_value())
+      return;
+    auto stream = SDL_IOFromConstMem(files[i]->data(), files[i]->size());
+    images[i] = IMG_Load_IO(stream, true);
+    if (images[i] == nullptr)
+      errors[i] = SDL_GetError();
+  });
+
+  for (size_t i = 0; i < files.size(); i++) {
+    if (!files[i].has_value()) {
+      log_message<LogLevel::Error>(SDL_LOG_CATEGORY_APPLICATION, "%s",
+                                   files[i].error().c_str());
+      continue;
+    }
+    if (images[i] == nullptr) {
+      log_message<LogLevel::Error>(SDL_LOG_CATEGORY_APPLICATION,
+                                   "Unable to load image %s: %s",
+                                   paths[i].c_str(), errors[i].c_str());
+      continue;
+    }
+    ctx->asset_manager->load_texture(ctx->device, found[i], images[i]);
+    SDL_DestroySurface(images[i]);
+  }
+  co_return;
+}
 } // namespace gatherer
@@ -2,8 +2,11 @@
 #include <expected>
 
 #include <SDL3/SDL_thread.h>
+#include <algorithm>
 #include <atomic>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <queue>
 #include <thread>
 
@@ -51,8 +54,13 @@ private:
   LightFuture<T> m_future;
 };
 
-struct ThreadPool {
-  std::queue<std::function<void()>> tasks;
+using TaskQueue = std::queue<
+    std::function<void()>,
+    std::deque<std::function<void()>,
+               TrackingAllocator<std::function<void()>, MemoryTag::ThreadPool>>>;
+
+struct ThreadPool : TrackedObject<MemoryTag::ThreadPool> {
+  TaskQueue tasks;
   SDL_Mutex *queue_mutex;
   SDL_Condition *condition;
   bool stop;
@@ -64,9 +72,12 @@ struct ThreadPool {
       std::function<void()> task;
 
       SDL_LockMutex(data->queue_mutex);
-      SDL_WaitCondition(data->condition, data->queue_mutex);
-      if (data->stop && data->tasks.empty())
+      while (!data->stop && data->tasks.empty())
+        SDL_WaitCondition(data->condition, data->queue_mutex);
+      if (data->stop && data->tasks.empty()) {
+        SDL_UnlockMutex(data->queue_mutex);
         return 0;
+      }
       task = std::move(data->tasks.front());
       data->tasks.pop();
       SDL_UnlockMutex(data->queue_mutex);
@@ -103,6 +114,49 @@ void task_submit(ThreadPool *pool, std::function<void()> task) {
   SDL_SignalCondition(pool->condition);
 }
 
+// Runs fn(0) .. fn(count - 1) across the pool and blocks until every index has
+// finished. The calling thread claims indices too, so progress never depends on
+// a worker waking up, and a null pool simply runs everything inline.
+struct ParallelBatch {
+  std::function<void(size_t)> fn;
+  size_t count;
+  std::atomic<size_t> next;
+  std::atomic<size_t> done;
+
+  ParallelBatch(std::function<void(size_t)> fn, size_t count)
+      : fn(std::move(fn)), count(count), next(0), done(0) {}
+
+  static void run(ParallelBatch *batch) {
+    size_t index;
+    while ((index = batch->next.fetch_add(1, std::memory_order_relaxed)) <
+           batch->count) {
+      batch->fn(index);
+      batch->done.fetch_add(1, std::memory_order_release);
+    }
+  }
+};
+
+void parallel_for(ThreadPool *pool, size_t count,
+                  std::function<void(size_t)> fn) {
+  if (pool == nullptr || count <= 1) {
+    for (size_t i = 0; i < count; i++)
+      fn(i);
+    return;
+  }
+
+  auto batch = std::allocate_shared<ParallelBatch>(
+      TrackingAllocator<ParallelBatch, MemoryTag::ThreadPool>{}, std::move(fn),
+      count);
+  auto helpers = std::min(pool->workers.size(), count - 1);
+  for (size_t i = 0; i < helpers; i++) {
+    task_submit(pool, [batch]() { ParallelBatch::run(batch.get()); });
+  }
+  ParallelBatch::run(batch.get());
+  while (batch->done.load(std::memory_order_acquire) < count) {
+    std::this_thread::yield();
+  }
+}
+
 template <typename T> struct Task {
   struct promise_type;
   using handle_type = std::coroutine_handle<promise_type>;
@@ -127,15 +181,21 @@ template <typename T> struct Task {
       coro.destroy();
   }
 
+  // Owns the awaited child once co_await has taken it from the Task, and
+  // destroys its frame when the awaiting expression ends.
   struct Awaiter {
     handle_type coro;
+    ~Awaiter() {
+      if (coro)
+        coro.destroy();
+    }
     bool await_ready() noexcept { return false; }
     void await_suspend(std::coroutine_handle<> awaiting) noexcept {
       coro.promise().continuation = awaiting;
       coro.resume();
     }
     std::expected<T, std::string> await_resume() noexcept {
-      return coro.promise().result;
+      return std::move(coro.promise().result);
     }
   };
 
@@ -145,18 +205,21 @@ template <typename T> struct Task {
     return Awaiter{tmp};
   }
 
-  struct promise_type {
+  struct promise_type : TrackedObject<MemoryTag::Coroutines> {
     std::expected<T, std::string> result;
     std::coroutine_handle<> continuation = nullptr;
 
     auto get_return_object() { return Task{handle_type::from_promise(*this)}; }
     std::suspend_always initial_suspend() noexcept { return {}; }
 
+    // Transfers to the awaiting coroutine instead of resuming it from here,
+    // since it destroys this frame as soon as its co_await completes.
     struct FinalAwaiter {
       bool await_ready() noexcept { return false; }
-      void await_suspend(handle_type handle) noexcept {
+      std::coroutine_handle<> await_suspend(handle_type handle) noexcept {
         if (handle.promise().continuation)
-          handle.promise().continuation.resume();
+          return handle.promise().continuation;
+        return std::noop_coroutine();
       }
       void await_resume() noexcept {}
     };
@@ -202,16 +265,23 @@ template <> struct Task<void> {
       coro.destroy();
   }
 
+  // Owns the awaited child like Task<T>::Awaiter. The child's FinalAwaiter
+  // touches nothing in its frame after handing the continuation to the pool,
+  // so the resumed parent may destroy it straight away.
   struct Awaiter {
     handle_type coro;
     Context *ctx;
+    ~Awaiter() {
+      if (coro)
+        coro.destroy();
+    }
     bool await_ready() noexcept { return false; }
     void await_suspend(std::coroutine_handle<> awaiting) noexcept {
       coro.promise().continuation = awaiting;
       task_submit(ctx->pool, [h = coro]() { h.resume(); });
     }
     std::expected<void, std::string> await_resume() noexcept {
-      return coro.promise().result;
+      return std::move(coro.promise().result);
     }
   };
 
@@ -221,12 +291,13 @@ template <> struct Task<void> {
     return Awaiter{tmp, tmp.promise().ctx};
   }
 
-  struct promise_type {
+  struct promise_type : TrackedObject<MemoryTag::Coroutines> {
     std::expected<void, std::string> result;
     std::coroutine_handle<> continuation = nullptr;
     Context *ctx;
 
-    promise_type(Context *ctx) : ctx(ctx) {}
+    template <typename... Args>
+    promise_type(Context *ctx, Args &&...) : ctx(ctx) {}
 
     auto get_return_object() { return Task{handle_type::from_promise(*this)}; }
     std::suspend_always initial_suspend() noexcept { return {}; }
@@ -1,4 +1,5 @@
 #include <SDL3/SDL_log.h>
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <cstddef>
@@ -8,7 +9,12 @@
 
 namespace gatherer {
 
-enum class EventType : uint8_t { KeyPressedEvent, DamageEvent, Count };
+enum class EventType : uint8_t {
+  KeyPressedEvent,
+  DamageEvent,
+  PathReadyEvent,
+  Count
+};
 
 struct EventHeader {
   EventType type;
@@ -38,14 +44,33 @@ struct DamageEvent {
   }
 };
 
+// Sent by the PathfindingService once a request has been solved. The path
+// itself is too large for the queue; listeners fetch it with take_result().
+struct PathReadyEvent {
+  EventHeader header;
+  uint32_t request;
+  uint32_t agent;
+  static constexpr EventType Type = EventType::PathReadyEvent;
+
+  PathReadyEvent(uint32_t request, uint32_t agent)
+      : request(request), agent(agent) {
+    header.type = Type;
+    header.size = static_cast<uint8_t>(sizeof(PathReadyEvent));
+  }
+};
+
 constexpr size_t MaxEventTypes = static_cast<size_t>(EventType::Count);
 constexpr size_t MaxListeners = 8;
-constexpr size_t MaxQueued = 64;
-constexpr size_t MaxEventBytes = sizeof(DamageEvent);
+constexpr size_t MaxQueued = 512;
+constexpr size_t MaxEventBytes =
+    std::max({sizeof(KeyPressedEvent), sizeof(DamageEvent),
+              sizeof(PathReadyEvent)});
 
 static_assert(sizeof(KeyPressedEvent) <= MaxEventBytes,
               "Increase MaxEventBytes");
 static_assert(sizeof(DamageEvent) <= MaxEventBytes, "Increase MaxEventBytes");
+static_assert(sizeof(PathReadyEvent) <= MaxEventBytes,
+              "Increase MaxEventBytes");
 
 using EventFunc = void (*)(void *event, void *context);
 
@@ -55,7 +80,7 @@ struct Listener {
   void *context;
 };
 
-class Dispatcher {
+class Dispatcher : public TrackedObject<MemoryTag::Dispatcher> {
 public:
   std::expected<void, std::string> subscribe(EventType type, EventFunc fn,
                                              void *context) {
@@ -8,11 +8,15 @@ namespace gatherer {
 class AssetManager;
 struct ThreadPool;
 class Dispatcher;
+class PathfindingService;
+class IoService;
 
 struct Context {
   AssetManager *asset_manager;
   ThreadPool *pool;
   gatherer::Dispatcher *dispatcher;
+  PathfindingService *pathfinder;
+  IoService *io;
   SDL_Window *window;
   SDL_GPUDevice *device;
   int width;
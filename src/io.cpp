@@ -0,0 +1,608 @@
+#include <SDL3/SDL_iostream.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <coroutine>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <new>
+#include <span>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define GATHERER_POSIX_IO 1
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define GATHERER_IO_URING 1
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+#include "gatherer.hpp"
+
+namespace gatherer {
+
+// Awaitable file reads for Task coroutines. On Linux reads go through an
+// io_uring: a whole batch is queued and handed to the kernel with a single
+// io_uring_enter, and a completion thread resumes the awaiting coroutine on
+// the ThreadPool. Elsewhere, when the kernel refuses io_uring, or once
+// io_uring_enter stops accepting submissions, each read runs as a blocking
+// task on the pool instead.
+
+using IoBuffer = std::vector<std::byte, TrackingAllocator<std::byte, MemoryTag::Io>>;
+
+constexpr uint32_t IoQueueDepth = 256;
+// io_uring_enter attempts on EAGAIN or EBUSY before staged reads are handed
+// to the pool instead.
+constexpr uint32_t IoSubmitRetries = 16;
+
+struct File {
+#ifdef GATHERER_POSIX_IO
+  int fd = -1;
+#else
+  SDL_IOStream *stream = nullptr;
+  SDL_Mutex *mutex = nullptr;
+#endif
+  uint64_t size = 0;
+};
+
+std::expected<File, std::string> open_file(const std::string &path) {
+  auto file = File{};
+#ifdef GATHERER_POSIX_IO
+  file.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (file.fd < 0)
+    return std::unexpected(path + ": " + std::strerror(errno));
+  struct stat info;
+  if (::fstat(file.fd, &info) != 0) {
+    auto error = path + ": " + std::strerror(errno);
+    ::close(file.fd);
+    return std::unexpected(error);
+  }
+  file.size = static_cast<uint64_t>(info.st_size);
+#else
+  file.stream = SDL_IOFromFile(path.c_str(), "rb");
+  if (file.stream == nullptr)
+    return std::unexpected(path + ": " + SDL_GetError());
+  auto size = SDL_GetIOSize(file.stream);
+  if (size < 0) {
+    auto error = path + ": " + SDL_GetError();
+    SDL_CloseIO(file.stream);
+    return std::unexpected(error);
+  }
+  file.size = static_cast<uint64_t>(size);
+  file.mutex = SDL_CreateMutex();
+#endif
+  return file;
+}
+
+void close_file(File &file) {
+#ifdef GATHERER_POSIX_IO
+  if (file.fd >= 0)
+    ::close(file.fd);
+  file.fd = -1;
+#else
+  if (file.stream != nullptr) {
+    SDL_CloseIO(file.stream);
+    SDL_DestroyMutex(file.mutex);
+  }
+  file.stream = nullptr;
+#endif
+}
+
+struct IoBatch;
+
+struct IoRequest {
+  File *file = nullptr;
+  uint64_t offset = 0;
+  std::byte *data = nullptr;
+  size_t length = 0;
+  size_t done = 0;
+  std::string error{};
+  IoBatch *batch = nullptr;
+#ifdef GATHERER_IO_URING
+  iovec iov{};
+#endif
+};
+
+// Requests that resume one coroutine once the last of them completes.
+struct IoBatch {
+  IoRequest *requests = nullptr;
+  size_t count = 0;
+  std::atomic<size_t> remaining = 0;
+  std::coroutine_handle<> continuation = nullptr;
+};
+
+// Reads until length bytes or end of file, like a loop of pread calls.
+static void read_blocking(IoRequest *request) {
+#ifdef GATHERER_POSIX_IO
+  while (request->done < request->length) {
+    auto n = ::pread(request->file->fd, request->data + request->done,
+                     request->length - request->done,
+                     static_cast<off_t>(request->offset + request->done));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0) {
+      request->error = std::strerror(errno);
+      return;
+    }
+    if (n == 0)
+      return;
+    request->done += static_cast<size_t>(n);
+  }
+#else
+  SDL_LockMutex(request->file->mutex);
+  if (SDL_SeekIO(request->file->stream,
+                 static_cast<Sint64>(request->offset + request->done),
+                 SDL_IO_SEEK_SET) < 0) {
+    request->error = SDL_GetError();
+  } else {
+    while (request->done < request->length) {
+      auto n = SDL_ReadIO(request->file->stream, request->data + request->done,
+                          request->length - request->done);
+      if (n == 0)
+        break;
+      request->done += n;
+    }
+  }
+  SDL_UnlockMutex(request->file->mutex);
+#endif
+}
+
+class IoService : public TrackedObject<MemoryTag::Io> {
+public:
+  IoService(ThreadPool *pool) : pool(pool) {
+#ifdef GATHERER_IO_URING
+    if (!setup_ring()) {
+      SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                  "io_uring unavailable, falling back to blocking reads");
+    }
+#endif
+  }
+
+  ~IoService() {
+#ifdef GATHERER_IO_URING
+    if (ring_fd >= 0) {
+      // Signalled outside the ring, so shutdown works even when
+      // io_uring_enter does not.
+      uint64_t one = 1;
+      (void)::write(stop_event, &one, sizeof(one));
+      SDL_WaitThread(completion_thread, nullptr);
+      teardown_ring();
+    }
+#endif
+  }
+
+  bool uses_io_uring() const {
+#ifdef GATHERER_IO_URING
+    return ring_fd >= 0 && !broken.load(std::memory_order_acquire);
+#else
+    return false;
+#endif
+  }
+
+  // Starts every read in the batch. The batch may complete, and its
+  // coroutine resume, before this returns, so nothing here touches it after
+  // the final submission.
+  void submit(IoBatch *batch) {
+    const auto requests = batch->requests;
+    const auto count = batch->count;
+    batch->remaining.store(count, std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++)
+      requests[i].batch = batch;
+
+#ifdef GATHERER_IO_URING
+    if (uses_io_uring()) {
+      SDL_LockMutex(sq_mutex);
+      for (size_t i = 0; i < count; i++) {
+        if (broken.load(std::memory_order_relaxed) || !stage_read(&requests[i]))
+          read_on_pool(&requests[i]);
+      }
+      flush();
+      SDL_UnlockMutex(sq_mutex);
+      return;
+    }
+#endif
+
+    for (size_t i = 0; i < count; i++)
+      read_on_pool(&requests[i]);
+  }
+
+private:
+  ThreadPool *pool;
+
+  void read_on_pool(IoRequest *request) {
+    task_submit(pool, [this, request]() {
+      read_blocking(request);
+      complete(request, true);
+    });
+  }
+
+  void complete(IoRequest *request, bool on_pool) {
+    auto batch = request->batch;
+    if (batch->remaining.fetch_sub(1, std::memory_order_acq_rel) != 1)
+      return;
+    if (on_pool)
+      batch->continuation.resume();
+    else
+      task_submit(pool, [h = batch->continuation]() { h.resume(); });
+  }
+
+#ifdef GATHERER_IO_URING
+  int ring_fd = -1;
+  SDL_Mutex *sq_mutex = nullptr;
+  SDL_Thread *completion_thread = nullptr;
+  // The kernel signals cq_event for every completion; stop_event tells the
+  // completion thread to exit.
+  int cq_event = -1;
+  int stop_event = -1;
+  // Set once io_uring_enter fails with a hard error. Later batches use the
+  // blocking fallback.
+  std::atomic<bool> broken = false;
+
+  void *sq_ptr = nullptr;
+  void *cq_ptr = nullptr;
+  size_t sq_ring_size = 0;
+  size_t cq_ring_size = 0;
+  io_uring_sqe *sqes = nullptr;
+  size_t sqes_size = 0;
+
+  unsigned *sq_head = nullptr;
+  unsigned *sq_tail = nullptr;
+  unsigned *sq_mask = nullptr;
+  unsigned *sq_entries = nullptr;
+  unsigned *sq_array = nullptr;
+  unsigned *cq_head = nullptr;
+  unsigned *cq_tail = nullptr;
+  unsigned *cq_mask = nullptr;
+  io_uring_cqe *cqes = nullptr;
+
+  int enter(uint32_t to_submit) {
+    int result;
+    do {
+      result = static_cast<int>(syscall(__NR_io_uring_enter, ring_fd,
+                                        to_submit, 0, 0, nullptr, 0));
+    } while (result < 0 && errno == EINTR);
+    return result;
+  }
+
+  bool setup_ring() {
+    io_uring_params params{};
+    ring_fd = static_cast<int>(
+        syscall(__NR_io_uring_setup, IoQueueDepth, &params));
+    if (ring_fd < 0)
+      return false;
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size =
+        params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    const bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap)
+      sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+
+    sq_ptr = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE,
+                  MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    cq_ptr = single_mmap ? sq_ptr
+                         : mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ring_fd,
+                                IORING_OFF_CQ_RING);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    auto sqes_ptr = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sq_ptr == MAP_FAILED || cq_ptr == MAP_FAILED || sqes_ptr == MAP_FAILED) {
+      sqes = sqes_ptr == MAP_FAILED ? nullptr
+                                    : static_cast<io_uring_sqe *>(sqes_ptr);
+      teardown_ring();
+      return false;
+    }
+    sqes = static_cast<io_uring_sqe *>(sqes_ptr);
+
+    auto sq = static_cast<char *>(sq_ptr);
+    sq_head = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+    sq_entries = reinterpret_cast<unsigned *>(sq + params.sq_off.ring_entries);
+    sq_array = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+    auto cq = static_cast<char *>(cq_ptr);
+    cq_head = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+
+    cq_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    stop_event = eventfd(0, EFD_CLOEXEC);
+    if (cq_event < 0 || stop_event < 0 ||
+        syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_EVENTFD,
+                &cq_event, 1) != 0) {
+      teardown_ring();
+      return false;
+    }
+
+    sq_mutex = SDL_CreateMutex();
+    completion_thread = SDL_CreateThread(reap, "io_uring", this);
+    if (completion_thread == nullptr) {
+      teardown_ring();
+      return false;
+    }
+    return true;
+  }
+
+  void teardown_ring() {
+    if (sqes != nullptr)
+      munmap(sqes, sqes_size);
+    if (cq_ptr != nullptr && cq_ptr != MAP_FAILED && cq_ptr != sq_ptr)
+      munmap(cq_ptr, cq_ring_size);
+    if (sq_ptr != nullptr && sq_ptr != MAP_FAILED)
+      munmap(sq_ptr, sq_ring_size);
+    if (sq_mutex != nullptr)
+      SDL_DestroyMutex(sq_mutex);
+    if (cq_event >= 0)
+      ::close(cq_event);
+    if (stop_event >= 0)
+      ::close(stop_event);
+    ::close(ring_fd);
+    ring_fd = cq_event = stop_event = -1;
+    sqes = nullptr;
+    sq_ptr = cq_ptr = nullptr;
+    sq_mutex = nullptr;
+  }
+
+  // The caller holds sq_mutex for everything touching the submission ring.
+  unsigned sq_pending() const {
+    return *sq_tail -
+           std::atomic_ref<unsigned>(*sq_head).load(std::memory_order_acquire);
+  }
+
+  // Hands every staged entry to the kernel. If io_uring_enter keeps failing,
+  // the staged reads are taken back off the ring and run on the pool instead,
+  // so a batch always completes. Returns false in that case.
+  bool flush() {
+    for (uint32_t attempt = 0; sq_pending() != 0;) {
+      auto result = enter(sq_pending());
+      if (result > 0)
+        continue;
+      auto error = result < 0 ? errno : EAGAIN;
+      if ((error == EAGAIN || error == EBUSY) && ++attempt < IoSubmitRetries) {
+        std::this_thread::yield();
+        continue;
+      }
+      if (error != EAGAIN && error != EBUSY &&
+          !broken.exchange(true, std::memory_order_acq_rel)) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "io_uring_enter failed (%s), falling back to blocking "
+                    "reads",
+                    std::strerror(error));
+      }
+      requeue_staged();
+      return false;
+    }
+    return true;
+  }
+
+  // Rolls the submission tail back over entries the kernel has not taken and
+  // runs their reads on the pool. Only io_uring_enter consumes entries, and
+  // the caller holds sq_mutex, so nothing else moves the ring meanwhile.
+  void requeue_staged() {
+    auto head =
+        std::atomic_ref<unsigned>(*sq_head).load(std::memory_order_acquire);
+    auto tail = *sq_tail;
+    std::atomic_ref<unsigned>(*sq_tail).store(head, std::memory_order_release);
+    for (; head != tail; head++) {
+      auto user_data = sqes[sq_array[head & *sq_mask]].user_data;
+      read_on_pool(reinterpret_cast<IoRequest *>(user_data));
+    }
+  }
+
+  // Returns nullptr when the ring is full and could not be flushed.
+  io_uring_sqe *stage_sqe() {
+    if (sq_pending() >= *sq_entries && !flush())
+      return nullptr;
+    auto tail = *sq_tail;
+    auto index = tail & *sq_mask;
+    auto sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    std::atomic_ref<unsigned>(*sq_tail).store(tail + 1,
+                                              std::memory_order_release);
+    return sqe;
+  }
+
+  bool stage_read(IoRequest *request) {
+    auto sqe = stage_sqe();
+    if (sqe == nullptr)
+      return false;
+    request->iov.iov_base = request->data + request->done;
+    request->iov.iov_len = request->length - request->done;
+    sqe->opcode = IORING_OP_READV;
+    sqe->fd = request->file->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(&request->iov);
+    sqe->len = 1;
+    sqe->off = request->offset + request->done;
+    sqe->user_data = reinterpret_cast<uint64_t>(request);
+    return true;
+  }
+
+  // Short reads are resubmitted for the remainder, so a request completes
+  // once it is full, hits end of file or fails.
+  void on_completion(IoRequest *request, int result) {
+    if (result < 0) {
+      request->error = std::strerror(-result);
+    } else if (result > 0) {
+      request->done += static_cast<size_t>(result);
+      if (request->done < request->length) {
+        SDL_LockMutex(sq_mutex);
+        if (broken.load(std::memory_order_relaxed) || !stage_read(request))
+          read_on_pool(request);
+        flush();
+        SDL_UnlockMutex(sq_mutex);
+        return;
+      }
+    }
+    complete(request, false);
+  }
+
+  // Waits on the ring's eventfd rather than in io_uring_enter, so reaping
+  // keeps working if io_uring_enter starts failing and shutdown never depends
+  // on a submission getting through.
+  static int reap(void *ptr) {
+    auto io = static_cast<IoService *>(ptr);
+    std::array<pollfd, 2> fds = {{{io->cq_event, POLLIN, 0},
+                                  {io->stop_event, POLLIN, 0}}};
+    while (true) {
+      if (::poll(fds.data(), fds.size(), -1) < 0)
+        continue;
+      if (fds[1].revents != 0)
+        return 0;
+      uint64_t signalled;
+      (void)::read(io->cq_event, &signalled, sizeof(signalled));
+
+      auto head =
+          std::atomic_ref<unsigned>(*io->cq_head).load(std::memory_order_relaxed);
+      auto tail =
+          std::atomic_ref<unsigned>(*io->cq_tail).load(std::memory_order_acquire);
+      for (; head != tail; head++) {
+        const auto &cqe = io->cqes[head & *io->cq_mask];
+        io->on_completion(reinterpret_cast<IoRequest *>(cqe.user_data),
+                          cqe.res);
+      }
+      std::atomic_ref<unsigned>(*io->cq_head).store(head,
+                                                    std::memory_order_release);
+    }
+  }
+#endif
+};
+
+struct ReadAtAwaiter {
+  IoService *io;
+  IoRequest request;
+  IoBatch batch;
+
+  bool await_ready() noexcept { return false; }
+  void await_suspend(std::coroutine_handle<> awaiting) {
+    batch.requests = &request;
+    batch.count = 1;
+    batch.continuation = awaiting;
+    io->submit(&batch);
+  }
+  std::expected<size_t, std::string> await_resume() {
+    if (!request.error.empty())
+      return std::unexpected(std::move(request.error));
+    return request.done;
+  }
+};
+
+// co_await read_at(ctx, file, offset, buffer) fills buffer from offset and
+// yields the number of bytes read, short only at end of file.
+ReadAtAwaiter read_at(Context *ctx, File &file, uint64_t offset,
+                      std::span<std::byte> buffer) {
+  return ReadAtAwaiter{.io = ctx->io,
+                       .request = IoRequest{.file = &file,
+                                            .offset = offset,
+                                            .data = buffer.data(),
+                                            .length = buffer.size()},
+                       .batch = {}};
+}
+
+using ReadFileResult = std::expected<IoBuffer, std::string>;
+
+struct ReadFilesAwaiter {
+  IoService *io;
+  std::vector<std::string> paths;
+  std::vector<ReadFileResult> results{};
+  std::vector<File> files{};
+  std::vector<IoRequest> requests{};
+  std::vector<size_t> request_path{};
+  IoBatch batch{};
+
+  bool await_ready() noexcept { return paths.empty(); }
+
+  // Opening and sizing happen here on the awaiting thread, the reads
+  // themselves all go out in one submission.
+  bool await_suspend(std::coroutine_handle<> awaiting) {
+    results.resize(paths.size());
+    files.reserve(paths.size());
+    requests.reserve(paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+      auto file = open_file(paths[i]);
+      if (!file.has_value()) {
+        results[i] = std::unexpected(std::move(file.error()));
+        continue;
+      }
+      // A "fail" budget on the io tag fails just this file.
+      try {
+        results[i] = IoBuffer(file->size);
+      } catch (const std::bad_alloc &) {
+        close_file(*file);
+        results[i] = std::unexpected(paths[i] + ": io memory budget exceeded");
+        continue;
+      }
+      files.push_back(*file);
+    }
+    for (size_t i = 0, f = 0; i < paths.size(); i++) {
+      if (!results[i].has_value())
+        continue;
+      auto &buffer = *results[i];
+      requests.push_back(IoRequest{
+          .file = &files[f++], .data = buffer.data(), .length = buffer.size()});
+      request_path.push_back(i);
+    }
+    if (requests.empty())
+      return false;
+
+    batch.requests = requests.data();
+    batch.count = requests.size();
+    batch.continuation = awaiting;
+    io->submit(&batch);
+    return true;
+  }
+
+  std::vector<ReadFileResult> await_resume() {
+    for (size_t r = 0; r < requests.size(); r++) {
+      auto &result = results[request_path[r]];
+      if (!requests[r].error.empty())
+        result = std::unexpected(paths[request_path[r]] + ": " +
+                                 requests[r].error);
+      else
+        result->resize(requests[r].done);
+    }
+    for (auto &file : files)
+      close_file(file);
+    return std::move(results);
+  }
+};
+
+// co_await read_files(ctx, paths) reads every file in one batch.
+ReadFilesAwaiter read_files(Context *ctx, std::vector<std::string> paths) {
+  return ReadFilesAwaiter{.io = ctx->io, .paths = std::move(paths)};
+}
+
+struct ReadFileAwaiter {
+  ReadFilesAwaiter files;
+
+  bool await_ready() noexcept { return files.await_ready(); }
+  bool await_suspend(std::coroutine_handle<> awaiting) {
+    return files.await_suspend(awaiting);
+  }
+  ReadFileResult await_resume() { return std::move(files.await_resume()[0]); }
+};
+
+// co_await read_file(ctx, path) yields the whole file.
+ReadFileAwaiter read_file(Context *ctx, std::string path) {
+  return ReadFileAwaiter{read_files(ctx, {std::move(path)})};
+}
+} // namespace gatherer
@@ -0,0 +1,325 @@
+#include <SDL3/SDL_log.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <SDL3/SDL_timer.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <expected>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace gatherer {
+
+// Asynchronous logging. Every thread formats into its own single producer
+// ring and a writer thread drains all rings in batches, so logging from a
+// pool worker never waits on stdio. SDL_Log* calls are routed through the
+// same rings once the logger is started.
+
+enum class LogLevel : uint8_t {
+  Trace = SDL_LOG_PRIORITY_TRACE,
+  Verbose = SDL_LOG_PRIORITY_VERBOSE,
+  Debug = SDL_LOG_PRIORITY_DEBUG,
+  Info = SDL_LOG_PRIORITY_INFO,
+  Warn = SDL_LOG_PRIORITY_WARN,
+  Error = SDL_LOG_PRIORITY_ERROR,
+  Critical = SDL_LOG_PRIORITY_CRITICAL,
+};
+
+// Messages below this level compile to nothing. Override with
+// -DGATHERER_LOG_LEVEL=<SDL_LogPriority value>.
+#ifndef GATHERER_LOG_LEVEL
+#ifdef GDEBUG
+#define GATHERER_LOG_LEVEL SDL_LOG_PRIORITY_DEBUG
+#else
+#define GATHERER_LOG_LEVEL SDL_LOG_PRIORITY_INFO
+#endif
+#endif
+constexpr LogLevel MinLogLevel = static_cast<LogLevel>(GATHERER_LOG_LEVEL);
+
+enum class LogFullPolicy : uint8_t { Drop, Block };
+
+struct LogConfig {
+  std::string file;
+  LogFullPolicy policy = LogFullPolicy::Drop;
+  uint32_t flush_interval_ms = 5;
+};
+
+constexpr size_t LogMessageBytes = 240;
+constexpr size_t LogRingSize = 256;
+constexpr size_t MaxLogThreads = 64;
+
+static_assert((LogRingSize & (LogRingSize - 1)) == 0,
+              "LogRingSize must be a power of two");
+
+struct LogRecord {
+  uint64_t timestamp;
+  int category;
+  SDL_LogPriority priority;
+  char text[LogMessageBytes];
+};
+
+struct LogRing {
+  alignas(64) std::atomic<size_t> head = 0;
+  alignas(64) std::atomic<size_t> tail = 0;
+  std::array<LogRecord, LogRingSize> records;
+};
+
+static const char *log_priority_name(SDL_LogPriority priority) {
+  switch (priority) {
+  case SDL_LOG_PRIORITY_TRACE:
+    return "TRACE";
+  case SDL_LOG_PRIORITY_VERBOSE:
+    return "VERBOSE";
+  case SDL_LOG_PRIORITY_DEBUG:
+    return "DEBUG";
+  case SDL_LOG_PRIORITY_INFO:
+    return "INFO";
+  case SDL_LOG_PRIORITY_WARN:
+    return "WARN";
+  case SDL_LOG_PRIORITY_ERROR:
+    return "ERROR";
+  case SDL_LOG_PRIORITY_CRITICAL:
+    return "CRITICAL";
+  default:
+    return "LOG";
+  }
+}
+
+class Logger {
+public:
+  std::expected<void, std::string> start(const LogConfig &log_config) {
+    config = log_config;
+    if (!config.file.empty()) {
+      file = std::fopen(config.file.c_str(), "w");
+      if (file == nullptr)
+        return std::unexpected("Unable to open log file " + config.file);
+    }
+    wake_mutex = SDL_CreateMutex();
+    wake = SDL_CreateCondition();
+    ring_count.store(0, std::memory_order_relaxed);
+    epoch.fetch_add(1, std::memory_order_relaxed);
+    running.store(true, std::memory_order_seq_cst);
+    writer_thread = SDL_CreateThread(writer, "logger", this);
+    if (writer_thread == nullptr) {
+      running.store(false, std::memory_order_release);
+      return std::unexpected(std::string(SDL_GetError()));
+    }
+    SDL_GetLogOutputFunction(&previous_output, &previous_userdata);
+    SDL_SetLogOutputFunction(sdl_output, this);
+    return std::expected<void, std::string>{};
+  }
+
+  // Drains everything still queued and hands SDL_Log back to its previous
+  // output. Logging after this point is written synchronously.
+  void stop() {
+    if (!running.exchange(false, std::memory_order_seq_cst))
+      return;
+    SDL_SetLogOutputFunction(previous_output, previous_userdata);
+    // Threads that saw running before the exchange may still be filling their
+    // ring. Wait for them so the final drain sees their messages and no ring
+    // is freed under a writer.
+    while (writers.load(std::memory_order_seq_cst) != 0)
+      std::this_thread::yield();
+    SDL_SignalCondition(wake);
+    SDL_WaitThread(writer_thread, nullptr);
+    SDL_DestroyCondition(wake);
+    SDL_DestroyMutex(wake_mutex);
+    if (file != nullptr)
+      std::fclose(file);
+    file = nullptr;
+
+    auto count = std::min(ring_count.load(std::memory_order_acquire),
+                          MaxLogThreads);
+    for (size_t i = 0; i < count; i++) {
+      auto ring = rings[i].exchange(nullptr, std::memory_order_acq_rel);
+      if (ring != nullptr) {
+        ring->~LogRing();
+        tracked_free(MemoryTag::Logging, ring, sizeof(LogRing),
+                     alignof(LogRing));
+      }
+    }
+  }
+
+  void write(int category, SDL_LogPriority priority, const char *fmt,
+             va_list args) {
+    // Counted before running is checked, so stop() can wait for every writer
+    // that might still touch a ring.
+    writers.fetch_add(1, std::memory_order_seq_cst);
+    auto ring = running.load(std::memory_order_seq_cst) ? thread_ring()
+                                                        : nullptr;
+    if (ring != nullptr)
+      push(ring, category, priority, fmt, args);
+    writers.fetch_sub(1, std::memory_order_seq_cst);
+
+    if (ring == nullptr) {
+      std::vfprintf(stderr, fmt, args);
+      std::fputc('\n', stderr);
+    }
+  }
+
+  void writef(int category, SDL_LogPriority priority, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    write(category, priority, fmt, args);
+    va_end(args);
+  }
+
+private:
+  LogConfig config;
+  FILE *file = nullptr;
+  SDL_Thread *writer_thread = nullptr;
+  SDL_Mutex *wake_mutex = nullptr;
+  SDL_Condition *wake = nullptr;
+  std::atomic<bool> running = false;
+  std::atomic<uint64_t> dropped = 0;
+  std::atomic<size_t> writers = 0;
+
+  std::array<std::atomic<LogRing *>, MaxLogThreads> rings{};
+  std::atomic<size_t> ring_count = 0;
+  // Bumped by every start() so rings claimed before a stop() are not reused.
+  std::atomic<uint64_t> epoch = 0;
+
+  SDL_LogOutputFunction previous_output = nullptr;
+  void *previous_userdata = nullptr;
+
+  void push(LogRing *ring, int category, SDL_LogPriority priority,
+            const char *fmt, va_list args) {
+    auto tail = ring->tail.load(std::memory_order_relaxed);
+    while (tail - ring->head.load(std::memory_order_acquire) >= LogRingSize) {
+      if (config.policy == LogFullPolicy::Drop ||
+          !running.load(std::memory_order_acquire)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+      }
+      SDL_SignalCondition(wake);
+      std::this_thread::yield();
+    }
+
+    auto &record = ring->records[tail & (LogRingSize - 1)];
+    record.timestamp = SDL_GetTicksNS();
+    record.category = category;
+    record.priority = priority;
+    std::vsnprintf(record.text, LogMessageBytes, fmt, args);
+    ring->tail.store(tail + 1, std::memory_order_release);
+
+    if (priority >= SDL_LOG_PRIORITY_ERROR)
+      SDL_SignalCondition(wake);
+  }
+
+  // Threads past MaxLogThreads get no ring and fall back to writing
+  // synchronously.
+  LogRing *thread_ring() {
+    thread_local LogRing *ring = nullptr;
+    thread_local uint64_t claimed = 0;
+    auto current = epoch.load(std::memory_order_relaxed);
+    if (claimed != current) {
+      claimed = current;
+      ring = nullptr;
+      auto slot = ring_count.fetch_add(1, std::memory_order_acq_rel);
+      if (slot < MaxLogThreads) {
+        ring = new (tracked_alloc(MemoryTag::Logging, sizeof(LogRing),
+                                  alignof(LogRing))) LogRing;
+        rings[slot].store(ring, std::memory_order_release);
+      }
+    }
+    return ring;
+  }
+
+  static void sdl_output(void *userdata, int category, SDL_LogPriority priority,
+                         const char *message) {
+    static_cast<Logger *>(userdata)->writef(category, priority, "%s", message);
+  }
+
+  // Appends every published record to batch, one ring after another. Records
+  // keep their order within a thread but not across threads.
+  size_t drain(std::string &batch) {
+    size_t drained = 0;
+    auto count = std::min(ring_count.load(std::memory_order_acquire),
+                          MaxLogThreads);
+    for (size_t i = 0; i < count; i++) {
+      auto ring = rings[i].load(std::memory_order_acquire);
+      if (ring == nullptr)
+        continue;
+      auto head = ring->head.load(std::memory_order_relaxed);
+      auto tail = ring->tail.load(std::memory_order_acquire);
+      for (; head != tail; head++) {
+        const auto &record = ring->records[head & (LogRingSize - 1)];
+        char prefix[48];
+        std::snprintf(prefix, sizeof(prefix), "[%10.4f] %s: ",
+                      double(record.timestamp) / SDL_NS_PER_SECOND,
+                      log_priority_name(record.priority));
+        // SDL_Log callers often end messages with their own newline.
+        std::string_view text = record.text;
+        while (!text.empty() && text.back() == '\n')
+          text.remove_suffix(1);
+        batch += prefix;
+        batch += text;
+        batch += '\n';
+        drained++;
+      }
+      ring->head.store(head, std::memory_order_release);
+    }
+
+    auto lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (lost != 0) {
+      batch += "WARN: ";
+      batch += std::to_string(lost);
+      batch += " log messages dropped\n";
+    }
+    return drained;
+  }
+
+  void flush(const std::string &batch) {
+    if (batch.empty())
+      return;
+    std::fwrite(batch.data(), 1, batch.size(), stderr);
+    std::fflush(stderr);
+    if (file != nullptr) {
+      std::fwrite(batch.data(), 1, batch.size(), file);
+      std::fflush(file);
+    }
+  }
+
+  static int writer(void *ptr) {
+    auto logger = static_cast<Logger *>(ptr);
+    std::string batch;
+    while (logger->running.load(std::memory_order_acquire)) {
+      batch.clear();
+      if (logger->drain(batch) == 0 && batch.empty()) {
+        SDL_LockMutex(logger->wake_mutex);
+        SDL_WaitConditionTimeout(
+            logger->wake, logger->wake_mutex,
+            static_cast<Sint32>(logger->config.flush_interval_ms));
+        SDL_UnlockMutex(logger->wake_mutex);
+        continue;
+      }
+      logger->flush(batch);
+    }
+    batch.clear();
+    logger->drain(batch);
+    logger->flush(batch);
+    return 0;
+  }
+};
+
+Logger &logger() {
+  static Logger instance;
+  return instance;
+}
+
+template <LogLevel Level>
+void log_message(int category, const char *fmt, ...) {
+  if constexpr (Level >= MinLogLevel) {
+    va_list args;
+    va_start(args, fmt);
+    logger().write(category, static_cast<SDL_LogPriority>(Level), fmt, args);
+    va_end(args);
+  }
+}
+} // namespace gatherer
@@ -4,9 +4,14 @@
 #include "SDL3/SDL_main.h"
 #include "toml.hpp"
 
-#include "assets.cpp"
+#include "memory.cpp"
+#include "log.cpp"
 #include "async.cpp"
 #include "events.cpp"
+#include "textures.cpp"
+#include "io.cpp"
+#include "assets.cpp"
+#include "pathfinding.cpp"
 #include "gatherer.hpp"
 #include <SDL3/SDL_gpu.h>
 
@@ -22,6 +27,19 @@ void on_damage_event(void *raw, void *) {
   SDL_assert(event->header.type == gatherer::EventType::DamageEvent);
 }
 
+void on_path_ready_event(void *raw, void *context) {
+  auto *event = reinterpret_cast<gatherer::PathReadyEvent *>(raw);
+  auto *pathfinder = static_cast<gatherer::PathfindingService *>(context);
+  SDL_assert(event != nullptr);
+  SDL_assert(event->header.type == gatherer::EventType::PathReadyEvent);
+  auto result = pathfinder->take_result(event->request);
+  if (result.has_value()) {
+    gatherer::log_message<gatherer::LogLevel::Debug>(
+        SDL_LOG_CATEGORY_APPLICATION, "Path %u for agent %u: %zu waypoints",
+        event->request, result->agent, result->path.size());
+  }
+}
+
 namespace gatherer {
 enum class ErrorCode { SDLError };
 
@@ -29,22 +47,55 @@ struct ErrorInfo {
   ErrorCode code;
 };
 
+Task<toml::table> load_config(Context *ctx, std::string path) {
+  auto file = co_await read_file(ctx, path);
+  if (!file.has_value())
+    co_return std::unexpected(file.error());
+  co_return toml::parse(
+      std::string_view(reinterpret_cast<const char *>(file->data()),
+                       file->size()),
+      path);
+}
+
+std::expected<void, std::string> configure_memory(const toml::table &config) {
+  auto memory = config["memory"];
+  memory_tracker().set_report_interval(
+      static_cast<uint64_t>(memory["report_interval"].value_or(int64_t{0})));
+  for (size_t i = 0; i < MaxMemoryTags; i++) {
+    auto budget = memory["budgets"][MemoryTagNames[i]];
+    auto limit = budget["limit"].value<int64_t>();
+    if (!limit.has_value())
+      continue;
+    auto policy = budget["policy"].value_or(std::string_view{"warn"});
+    auto result = memory_tracker().set_budget(
+        static_cast<MemoryTag>(i),
+        MemoryBudget{static_cast<size_t>(*limit),
+                     policy == "fail" ? BudgetPolicy::Fail
+                                      : BudgetPolicy::Warn});
+    if (!result.has_value())
+      return result;
+  }
+  return std::expected<void, std::string>{};
+}
+
 Task<void> input_system(Context *ctx) {
   DamageEvent damage = DamageEvent(5, 10);
   auto result = ctx->dispatcher->queue_event(&damage);
   if (!result.has_value()) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", result.error().c_str());
+    log_message<LogLevel::Error>(SDL_LOG_CATEGORY_APPLICATION, "%s",
+                                 result.error().c_str());
   }
   KeyPressedEvent key_press = KeyPressedEvent(66);
   result = ctx->dispatcher->queue_event(&key_press);
   if (!result.has_value()) {
-    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", result.error().c_str());
+    log_message<LogLevel::Error>(SDL_LOG_CATEGORY_APPLICATION, "%s",
+                                 result.error().c_str());
   }
   co_return;
 }
 
 Task<void> ai_system(Context *ctx) {
-  (void)ctx;
+  ctx->pathfinder->update(ctx->pool, ctx->dispatcher);
   co_return;
 }
 
@@ -52,12 +103,14 @@ Task<void> physics_system(Context *ctx) {
   auto result = co_await input_system(ctx);
   if (result.has_value()) {
   } else {
-    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Error: %s", result.error().c_str());
+    log_message<LogLevel::Error>(SDL_LOG_CATEGORY_ERROR, "Error: %s",
+                                 result.error().c_str());
   }
   result = co_await ai_system(ctx);
   if (result.has_value()) {
   } else {
-    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Error: %s", result.error().c_str());
+    log_message<LogLevel::Error>(SDL_LOG_CATEGORY_ERROR, "Error: %s",
+                                 result.error().c_str());
   }
 
   co_return;
@@ -67,7 +120,8 @@ Task<void> ui_system(Context *ctx) {
   auto result = co_await physics_system(ctx);
   if (result.has_value()) {
   } else {
-    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Error: %s", result.error().c_str());
+    log_message<LogLevel::Error>(SDL_LOG_CATEGORY_ERROR, "Error: %s",
+                                 result.error().c_str());
   }
   co_return;
 }
@@ -76,7 +130,8 @@ Task<void> game_update_system(Context *ctx) {
   auto result = co_await ui_system(ctx);
   if (result.has_value()) {
   } else {
-    SDL_LogError(SDL_LOG_CATEGORY_ERROR, "Error: %s", result.error().c_str());
+    log_message<LogLevel::Error>(SDL_LOG_CATEGORY_ERROR, "Error: %s",
+                                 result.error().c_str());
   }
   co_return;
 }
@@ -93,9 +148,44 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s\n", SDL_GetError());
     return SDL_APP_FAILURE;
   }
-  auto config = toml::parse_file("resources/config.toml");
+
+  ctx->pool = new gatherer::ThreadPool(4);
+  ctx->io = new gatherer::IoService(ctx->pool);
+
+  auto config_task = gatherer::load_config(ctx, "resources/config.toml");
+  config_task.coro.resume();
+  while (!config_task.coro.done()) {
+    std::this_thread::yield();
+  }
+  auto config_result = std::move(config_task.coro.promise().result);
+  if (!config_result.has_value()) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s\n",
+                 config_result.error().c_str());
+    return SDL_APP_FAILURE;
+  }
+  const auto &config = *config_result;
+
+  auto log_config = gatherer::LogConfig{};
+  log_config.file = config["log"]["file"].value_or(std::string{});
+  log_config.policy =
+      config["log"]["policy"].value_or(std::string_view{"drop"}) == "block"
+          ? gatherer::LogFullPolicy::Block
+          : gatherer::LogFullPolicy::Drop;
+  log_config.flush_interval_ms = static_cast<uint32_t>(
+      config["log"]["flush_interval_ms"].value_or(int64_t{5}));
+  auto log_result = gatherer::logger().start(log_config);
+  if (!log_result.has_value()) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s",
+                 log_result.error().c_str());
+  }
   ctx->width = config["window"]["width"].node()->as_integer()->get();
   ctx->height = config["window"]["height"].node()->as_integer()->get();
+  auto memory_result = gatherer::configure_memory(config);
+  if (!memory_result.has_value()) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s\n",
+                 memory_result.error().c_str());
+    return SDL_APP_FAILURE;
+  }
   ctx->window = SDL_CreateWindow("Gatherer", ctx->width, ctx->height, 0);
   if (ctx->window == nullptr) {
     SDL_LogError(SDL_LOG_CATEGORY_VIDEO, "%s\n", SDL_GetError());
@@ -107,10 +197,36 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
     return SDL_APP_FAILURE;
   }
 
-  ctx->asset_manager = new gatherer::AssetManager;
-  ctx->pool = new gatherer::ThreadPool(4);
+  ctx->asset_manager = new gatherer::AssetManager(ctx->pool);
   ctx->dispatcher = new gatherer::Dispatcher;
 
+  auto cluster_size =
+      config["pathfinding"]["cluster_size"].value_or(int64_t{16});
+  auto world_width = config["world"]["width"].value_or(int64_t{128});
+  auto world_height = config["world"]["height"].value_or(int64_t{128});
+  constexpr auto max_extent = int64_t{std::numeric_limits<int32_t>::max()};
+  if (cluster_size <= 0 || cluster_size > max_extent || world_width <= 0 ||
+      world_width > max_extent || world_height <= 0 ||
+      world_height > max_extent) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                 "pathfinding.cluster_size, world.width and world.height must "
+                 "be positive 32 bit integers\n");
+    return SDL_APP_FAILURE;
+  }
+
+  auto pathfinding_config = gatherer::PathfindingConfig{};
+  pathfinding_config.cluster_size = static_cast<int32_t>(cluster_size);
+  pathfinding_config.flow_field_threshold = static_cast<uint32_t>(
+      config["pathfinding"]["flow_field_threshold"].value_or(int64_t{8}));
+  pathfinding_config.frame_budget_ns =
+      static_cast<uint64_t>(
+          config["pathfinding"]["frame_budget_us"].value_or(int64_t{2000})) *
+      SDL_NS_PER_US;
+  auto grid = gatherer::TileGrid(static_cast<int32_t>(world_width),
+                                 static_cast<int32_t>(world_height));
+  ctx->pathfinder = new gatherer::PathfindingService(
+      ctx->pool, std::move(grid), pathfinding_config);
+
   if (!SDL_ClaimWindowForGPUDevice(ctx->device, ctx->window)) {
     SDL_LogError(SDL_LOG_CATEGORY_GPU, "%s\n", SDL_GetError());
     return SDL_APP_FAILURE;
@@ -118,6 +234,19 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
   SDL_LogInfo(SDL_LOG_CATEGORY_VIDEO, "Window: Width: %d, Height: %d\n",
               ctx->width, ctx->height);
 
+  std::vector<std::string> preload;
+  if (auto textures = config["assets"]["preload"].as_array()) {
+    for (const auto &texture : *textures) {
+      if (auto name = texture.value<std::string>())
+        preload.push_back(*name);
+    }
+  }
+  auto preload_task = gatherer::preload_textures(ctx, std::move(preload));
+  preload_task.coro.resume();
+  while (!preload_task.coro.done()) {
+    std::this_thread::yield();
+  }
+
   auto result = ctx->dispatcher->subscribe(gatherer::EventType::KeyPressedEvent,
                                            on_input_event, nullptr);
   if (!result.has_value()) {
@@ -128,6 +257,11 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
   if (!result.has_value()) {
     SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", result.error().c_str());
   }
+  result = ctx->dispatcher->subscribe(gatherer::EventType::PathReadyEvent,
+                                      on_path_ready_event, ctx->pathfinder);
+  if (!result.has_value()) {
+    SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", result.error().c_str());
+  }
 
   return SDL_APP_CONTINUE;
 }
@@ -163,6 +297,7 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
   }
 
   ctx->dispatcher->update();
+  gatherer::memory_tracker().end_frame();
 
   std::this_thread::sleep_for(std::chrono::milliseconds(16));
   return SDL_APP_CONTINUE;
@@ -175,10 +310,16 @@ void SDL_AppQuit(void *appstate, SDL_AppResult result) {
   gatherer::Context *ctx = static_cast<gatherer::Context *>(appstate);
 
   ctx->asset_manager->unload_assets(ctx->device);
+  delete (ctx->pathfinder);
+  delete (ctx->io);
   delete (ctx->pool);
   delete (ctx->asset_manager);
   delete (ctx->dispatcher);
   SDL_ReleaseWindowFromGPUDevice(ctx->device, ctx->window);
   SDL_DestroyGPUDevice(ctx->device);
   SDL_DestroyWindow(ctx->window);
+
+  gatherer::memory_tracker().report(SDL_LOG_PRIORITY_INFO);
+  gatherer::logger().stop();
+  gatherer::memory_tracker().report_leaks();
 }
@@ -0,0 +1,280 @@
+#include <SDL3/SDL_log.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <new>
+#include <string>
+#include <string_view>
+
+namespace gatherer {
+
+enum class MemoryTag : uint8_t {
+  Assets,
+  Textures,
+  Dispatcher,
+  ThreadPool,
+  Coroutines,
+  Pathfinding,
+  Logging,
+  Io,
+  Count
+};
+
+constexpr size_t MaxMemoryTags = static_cast<size_t>(MemoryTag::Count);
+constexpr size_t MaxTrackedThreads = 64;
+
+constexpr std::array<std::string_view, MaxMemoryTags> MemoryTagNames = {
+    "assets",     "textures",   "dispatcher",
+    "thread_pool", "coroutines", "pathfinding", "logging",
+    "io"};
+
+enum class BudgetPolicy : uint8_t { None, Warn, Fail };
+
+// Whether BudgetPolicy::Fail may throw from a tag's allocations. Textures are
+// only allocated inside process_texture() and file buffers inside
+// read_files(), and both turn std::bad_alloc into an error. The other tags
+// allocate where an exception would terminate the process: thread
+// pool tasks are submitted from noexcept await_suspend, log rings from SDL's
+// C log callback, pathfinding inside pool tasks, and the asset manager,
+// dispatcher and top level coroutine frames directly in SDL_AppInit and
+// SDL_AppIterate.
+constexpr std::array<bool, MaxMemoryTags> MemoryTagCanFail = {
+    false, // assets
+    true,  // textures
+    false, // dispatcher
+    false, // thread_pool
+    false, // coroutines
+    false, // pathfinding
+    false, // logging
+    true,  // io
+};
+
+struct MemoryBudget {
+  size_t limit;
+  BudgetPolicy policy;
+};
+
+struct MemoryStats {
+  size_t live;
+  size_t peak;
+  uint64_t frame_allocations;
+  uint64_t frame_bytes;
+};
+
+// Allocation churn is counted per thread so the hot path only ever touches a
+// cache line owned by the allocating thread. Live and peak bytes have to be
+// global to enforce budgets at allocation time, so those are shared atomics.
+struct alignas(64) ThreadMemoryCounters {
+  std::array<std::atomic<uint64_t>, MaxMemoryTags> allocations{};
+  std::array<std::atomic<uint64_t>, MaxMemoryTags> bytes{};
+};
+
+class MemoryTracker {
+public:
+  std::expected<void, std::string> set_budget(MemoryTag tag,
+                                              MemoryBudget budget) {
+    auto index = static_cast<size_t>(tag);
+    if (budget.policy == BudgetPolicy::Fail && !MemoryTagCanFail[index])
+      return std::unexpected("Memory budget for " +
+                             std::string(MemoryTagNames[index]) +
+                             " cannot use the fail policy");
+    auto &state = tags[index];
+    state.limit.store(budget.limit, std::memory_order_relaxed);
+    state.policy.store(budget.policy, std::memory_order_relaxed);
+    return std::expected<void, std::string>{};
+  }
+
+  void set_report_interval(uint64_t frames) { report_interval = frames; }
+
+  void on_alloc(MemoryTag tag, size_t size) {
+    auto index = static_cast<size_t>(tag);
+    auto &state = tags[index];
+    auto live = state.live.fetch_add(size, std::memory_order_relaxed) + size;
+
+    auto limit = state.limit.load(std::memory_order_relaxed);
+    if (limit != 0 && live > limit) {
+      switch (state.policy.load(std::memory_order_relaxed)) {
+      case BudgetPolicy::Fail:
+        state.live.fetch_sub(size, std::memory_order_relaxed);
+        SDL_LogError(SDL_LOG_CATEGORY_APPLICATION,
+                     "Memory budget for %s exceeded: %zu of %zu bytes",
+                     MemoryTagNames[index].data(), live, limit);
+        throw std::bad_alloc();
+      case BudgetPolicy::Warn:
+        if (!state.over_budget.exchange(true, std::memory_order_relaxed)) {
+          SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                      "Memory budget for %s exceeded: %zu of %zu bytes",
+                      MemoryTagNames[index].data(), live, limit);
+        }
+        break;
+      case BudgetPolicy::None:
+        break;
+      }
+    }
+
+    auto peak = state.peak.load(std::memory_order_relaxed);
+    while (live > peak && !state.peak.compare_exchange_weak(
+                              peak, live, std::memory_order_relaxed)) {
+    }
+
+    auto counters = thread_counters();
+    counters->allocations[index].fetch_add(1, std::memory_order_relaxed);
+    counters->bytes[index].fetch_add(size, std::memory_order_relaxed);
+  }
+
+  void on_free(MemoryTag tag, size_t size) {
+    auto &state = tags[static_cast<size_t>(tag)];
+    auto live = state.live.fetch_sub(size, std::memory_order_relaxed) - size;
+    auto limit = state.limit.load(std::memory_order_relaxed);
+    if (limit != 0 && live <= limit)
+      state.over_budget.store(false, std::memory_order_relaxed);
+  }
+
+  MemoryStats stats(MemoryTag tag) const {
+    auto index = static_cast<size_t>(tag);
+    return MemoryStats{tags[index].live.load(std::memory_order_relaxed),
+                       tags[index].peak.load(std::memory_order_relaxed),
+                       last_frame_allocations[index], last_frame_bytes[index]};
+  }
+
+  // Called once per frame from the main thread. Collects the per thread
+  // counters for the frame that just ended and logs them every
+  // report_interval frames.
+  void end_frame() {
+    std::array<uint64_t, MaxMemoryTags> allocations{};
+    std::array<uint64_t, MaxMemoryTags> bytes{};
+    auto threads = std::min(thread_count.load(std::memory_order_acquire),
+                            MaxTrackedThreads);
+    for (size_t t = 0; t < threads; t++) {
+      for (size_t i = 0; i < MaxMemoryTags; i++) {
+        allocations[i] += threads_counters[t].allocations[i].exchange(
+            0, std::memory_order_relaxed);
+        bytes[i] +=
+            threads_counters[t].bytes[i].exchange(0, std::memory_order_relaxed);
+      }
+    }
+    last_frame_allocations = allocations;
+    last_frame_bytes = bytes;
+
+    frame++;
+    if (report_interval != 0 && frame % report_interval == 0)
+      report(SDL_LOG_PRIORITY_INFO);
+  }
+
+  void report(SDL_LogPriority priority) const {
+    for (size_t i = 0; i < MaxMemoryTags; i++) {
+      auto s = stats(static_cast<MemoryTag>(i));
+      SDL_LogMessage(SDL_LOG_CATEGORY_APPLICATION, priority,
+                     "Memory %s: live %zu, peak %zu, allocations/frame %llu "
+                     "(%llu bytes)",
+                     MemoryTagNames[i].data(), s.live, s.peak,
+                     static_cast<unsigned long long>(s.frame_allocations),
+                     static_cast<unsigned long long>(s.frame_bytes));
+    }
+  }
+
+  // Anything still live at shutdown was never released by its subsystem.
+  void report_leaks() const {
+    for (size_t i = 0; i < MaxMemoryTags; i++) {
+      auto live = tags[i].live.load(std::memory_order_relaxed);
+      if (live != 0) {
+        SDL_LogWarn(SDL_LOG_CATEGORY_APPLICATION,
+                    "Memory %s: %zu bytes still allocated at shutdown",
+                    MemoryTagNames[i].data(), live);
+      }
+    }
+  }
+
+private:
+  struct TagState {
+    std::atomic<size_t> live = 0;
+    std::atomic<size_t> peak = 0;
+    std::atomic<size_t> limit = 0;
+    std::atomic<BudgetPolicy> policy = BudgetPolicy::None;
+    std::atomic<bool> over_budget = false;
+  };
+
+  std::array<TagState, MaxMemoryTags> tags{};
+  std::array<ThreadMemoryCounters, MaxTrackedThreads> threads_counters{};
+  std::atomic<size_t> thread_count = 0;
+  std::array<uint64_t, MaxMemoryTags> last_frame_allocations{};
+  std::array<uint64_t, MaxMemoryTags> last_frame_bytes{};
+  uint64_t frame = 0;
+  uint64_t report_interval = 0;
+
+  // Threads past MaxTrackedThreads share the last slot. The counters are
+  // atomic, so that only costs contention, not accuracy.
+  ThreadMemoryCounters *thread_counters() {
+    thread_local ThreadMemoryCounters *counters =
+        &threads_counters[std::min(
+            thread_count.fetch_add(1, std::memory_order_acq_rel),
+            MaxTrackedThreads - 1)];
+    return counters;
+  }
+};
+
+MemoryTracker &memory_tracker() {
+  static MemoryTracker tracker;
+  return tracker;
+}
+
+void *tracked_alloc(MemoryTag tag, size_t size,
+                    size_t align = alignof(std::max_align_t)) {
+  memory_tracker().on_alloc(tag, size);
+  try {
+    if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+      return ::operator new(size, std::align_val_t(align));
+    return ::operator new(size);
+  } catch (...) {
+    memory_tracker().on_free(tag, size);
+    throw;
+  }
+}
+
+void tracked_free(MemoryTag tag, void *ptr, size_t size,
+                  size_t align = alignof(std::max_align_t)) noexcept {
+  if (ptr == nullptr)
+    return;
+  memory_tracker().on_free(tag, size);
+  if (align > __STDCPP_DEFAULT_NEW_ALIGNMENT__)
+    ::operator delete(ptr, size, std::align_val_t(align));
+  else
+    ::operator delete(ptr, size);
+}
+
+// Standard allocator for containers owned by a subsystem.
+template <typename T, MemoryTag Tag> struct TrackingAllocator {
+  using value_type = T;
+  template <typename U> struct rebind {
+    using other = TrackingAllocator<U, Tag>;
+  };
+
+  TrackingAllocator() noexcept = default;
+  template <typename U>
+  TrackingAllocator(const TrackingAllocator<U, Tag> &) noexcept {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(tracked_alloc(Tag, n * sizeof(T), alignof(T)));
+  }
+  void deallocate(T *ptr, size_t n) noexcept {
+    tracked_free(Tag, ptr, n * sizeof(T), alignof(T));
+  }
+
+  template <typename U>
+  bool operator==(const TrackingAllocator<U, Tag> &) const noexcept {
+    return true;
+  }
+};
+
+// Base for heap allocated subsystem objects and coroutine promises, so that
+// `new` of the object (or the coroutine frame) is charged to Tag.
+template <MemoryTag Tag> struct TrackedObject {
+  static void *operator new(size_t size) { return tracked_alloc(Tag, size); }
+  static void operator delete(void *ptr, size_t size) noexcept {
+    tracked_free(Tag, ptr, size);
+  }
+};
+} // namespace gatherer
@@ -0,0 +1,734 @@
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_timer.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "gatherer.hpp"
+
+namespace gatherer {
+
+// Grid pathfinding for ai_system. Single queries use hierarchical A* (HPA*):
+// the grid is cut into square clusters, border crossings become nodes of an
+// abstract graph, and a query searches that graph before refining each hop
+// with A* bounded to one cluster and smoothing the result. When many agents
+// head for the same tile in one batch they share a flow field instead.
+
+template <typename T>
+using PathVector = std::vector<T, TrackingAllocator<T, MemoryTag::Pathfinding>>;
+
+template <typename K, typename V>
+using PathMap =
+    std::unordered_map<K, V, std::hash<K>, std::equal_to<K>,
+                       TrackingAllocator<std::pair<const K, V>,
+                                         MemoryTag::Pathfinding>>;
+
+constexpr uint32_t PathUnreachable = std::numeric_limits<uint32_t>::max();
+constexpr int32_t MaxEntranceWidth = 6;
+constexpr size_t MaxCachedFlowFields = 32;
+// Length of the stretches smooth_path() re-solves, in cluster widths.
+constexpr int32_t SmoothWindowClusters = 2;
+
+struct GridPoint {
+  int32_t x;
+  int32_t y;
+
+  bool operator==(const GridPoint &) const = default;
+};
+
+constexpr std::array<GridPoint, 4> GridNeighbours = {
+    {{1, 0}, {-1, 0}, {0, 1}, {0, -1}}};
+
+struct GridRect {
+  int32_t x;
+  int32_t y;
+  int32_t w;
+  int32_t h;
+
+  bool contains(GridPoint p) const {
+    return p.x >= x && p.y >= y && p.x < x + w && p.y < y + h;
+  }
+};
+
+static inline uint32_t manhattan(GridPoint a, GridPoint b) {
+  return static_cast<uint32_t>(std::abs(a.x - b.x) + std::abs(a.y - b.y));
+}
+
+// Cost of entering each tile, 0 marks a blocked tile.
+struct TileGrid {
+  int32_t width;
+  int32_t height;
+  PathVector<uint8_t> costs;
+
+  TileGrid(int32_t width, int32_t height, uint8_t cost = 1)
+      : width(width), height(height),
+        costs(size_t(width) * size_t(height), cost) {}
+
+  bool in_bounds(GridPoint p) const {
+    return p.x >= 0 && p.y >= 0 && p.x < width && p.y < height;
+  }
+  size_t index(GridPoint p) const { return size_t(p.y) * width + p.x; }
+  GridPoint point(size_t index) const {
+    return GridPoint{int32_t(index % width), int32_t(index / width)};
+  }
+  uint8_t cost(GridPoint p) const { return costs[index(p)]; }
+  bool passable(GridPoint p) const { return in_bounds(p) && cost(p) != 0; }
+};
+
+// Open list entry ordered by f then g so ties expand the deeper node first.
+struct OpenEntry {
+  uint32_t f;
+  uint32_t g;
+  uint32_t node;
+
+  bool operator>(const OpenEntry &other) const {
+    return f != other.f ? f > other.f : g < other.g;
+  }
+};
+
+// Per thread search state reused across queries. Generation stamps stand in
+// for clearing the arrays between searches. The buffers live in thread_locals
+// of detached pool workers and are never released before the leak report, so
+// they are deliberately left out of the pathfinding memory budget.
+struct SearchScratch {
+  std::vector<uint32_t> g;
+  std::vector<uint32_t> parent;
+  std::vector<uint32_t> seen;
+  std::vector<uint32_t> closed;
+  std::vector<OpenEntry> open;
+  uint32_t generation = 0;
+
+  void begin(size_t size) {
+    if (g.size() < size) {
+      g.resize(size);
+      parent.resize(size);
+      seen.assign(size, 0);
+      closed.assign(size, 0);
+      generation = 0;
+    }
+    open.clear();
+    if (++generation == 0) {
+      std::fill(seen.begin(), seen.end(), 0);
+      std::fill(closed.begin(), closed.end(), 0);
+      generation = 1;
+    }
+  }
+
+  bool visited(uint32_t node) const { return seen[node] == generation; }
+  bool is_closed(uint32_t node) const { return closed[node] == generation; }
+
+  void push(uint32_t node, uint32_t g_cost, uint32_t h, uint32_t from) {
+    seen[node] = generation;
+    g[node] = g_cost;
+    parent[node] = from;
+    open.push_back(OpenEntry{g_cost + h, g_cost, node});
+    std::push_heap(open.begin(), open.end(), std::greater<>{});
+  }
+
+  OpenEntry pop() {
+    std::pop_heap(open.begin(), open.end(), std::greater<>{});
+    auto entry = open.back();
+    open.pop_back();
+    return entry;
+  }
+};
+
+// A* over the tiles inside rect. Returns the path cost and, when out is set,
+// appends the tiles after start up to and including goal.
+static std::optional<uint32_t> search_rect(const TileGrid &grid, GridRect rect,
+                                           GridPoint start, GridPoint goal,
+                                           PathVector<GridPoint> *out) {
+  thread_local SearchScratch scratch;
+  auto local = [&](GridPoint p) {
+    return uint32_t((p.y - rect.y) * rect.w + (p.x - rect.x));
+  };
+  auto global = [&](uint32_t node) {
+    return GridPoint{rect.x + int32_t(node % rect.w),
+                     rect.y + int32_t(node / rect.w)};
+  };
+
+  scratch.begin(size_t(rect.w) * rect.h);
+  const auto start_node = local(start);
+  const auto goal_node = local(goal);
+  scratch.push(start_node, 0, manhattan(start, goal), start_node);
+
+  while (!scratch.open.empty()) {
+    auto entry = scratch.pop();
+    if (scratch.is_closed(entry.node) || entry.g != scratch.g[entry.node])
+      continue;
+    scratch.closed[entry.node] = scratch.generation;
+
+    if (entry.node == goal_node) {
+      if (out != nullptr) {
+        auto first = out->size();
+        for (auto node = goal_node; node != start_node;
+             node = scratch.parent[node])
+          out->push_back(global(node));
+        std::reverse(out->begin() + first, out->end());
+      }
+      return entry.g;
+    }
+
+    auto p = global(entry.node);
+    for (auto d : GridNeighbours) {
+      auto next = GridPoint{p.x + d.x, p.y + d.y};
+      if (!rect.contains(next) || !grid.passable(next))
+        continue;
+      auto node = local(next);
+      auto g = entry.g + grid.cost(next);
+      if (scratch.is_closed(node) ||
+          (scratch.visited(node) && scratch.g[node] <= g))
+        continue;
+      scratch.push(node, g, manhattan(next, goal), entry.node);
+    }
+  }
+  return std::nullopt;
+}
+
+// Integration field towards a single target plus the neighbour each tile
+// should step to. Shared read-only between every agent with that target.
+struct FlowField {
+  GridPoint target;
+  PathVector<uint32_t> integration;
+  PathVector<int8_t> direction;
+
+  FlowField(const TileGrid &grid, GridPoint target)
+      : target(target), integration(grid.costs.size(), PathUnreachable),
+        direction(grid.costs.size(), -1) {
+    PathVector<OpenEntry> open;
+    integration[grid.index(target)] = 0;
+    open.push_back(OpenEntry{0, 0, uint32_t(grid.index(target))});
+    while (!open.empty()) {
+      std::pop_heap(open.begin(), open.end(), std::greater<>{});
+      auto entry = open.back();
+      open.pop_back();
+      if (entry.f != integration[entry.node])
+        continue;
+      // Cost of stepping from p to its neighbour is the neighbour's cost, so
+      // walking back from the neighbour to p costs cost(p).
+      auto p = grid.point(entry.node);
+      for (auto d : GridNeighbours) {
+        auto next = GridPoint{p.x + d.x, p.y + d.y};
+        if (!grid.passable(next))
+          continue;
+        auto index = grid.index(next);
+        auto cost = entry.f + grid.cost(p);
+        if (cost < integration[index]) {
+          integration[index] = cost;
+          open.push_back(OpenEntry{cost, cost, uint32_t(index)});
+          std::push_heap(open.begin(), open.end(), std::greater<>{});
+        }
+      }
+    }
+
+    // Stepping to a neighbour costs entering it, so the best step is the one
+    // that minimises that plus the neighbour's own integration value.
+    for (size_t i = 0; i < integration.size(); i++) {
+      if (integration[i] == PathUnreachable || integration[i] == 0)
+        continue;
+      auto p = grid.point(i);
+      auto best = PathUnreachable;
+      for (size_t d = 0; d < GridNeighbours.size(); d++) {
+        auto next = GridPoint{p.x + GridNeighbours[d].x,
+                              p.y + GridNeighbours[d].y};
+        if (!grid.passable(next) ||
+            integration[grid.index(next)] == PathUnreachable)
+          continue;
+        auto through = integration[grid.index(next)] + grid.cost(next);
+        if (through < best) {
+          best = through;
+          direction[i] = static_cast<int8_t>(d);
+        }
+      }
+    }
+  }
+
+  bool reachable(const TileGrid &grid, GridPoint from) const {
+    return grid.in_bounds(from) &&
+           integration[grid.index(from)] != PathUnreachable;
+  }
+
+  // Next tile towards the target, or nullopt at the target or when
+  // unreachable.
+  std::optional<GridPoint> next(const TileGrid &grid, GridPoint from) const {
+    if (!grid.in_bounds(from))
+      return std::nullopt;
+    auto d = direction[grid.index(from)];
+    if (d < 0)
+      return std::nullopt;
+    return GridPoint{from.x + GridNeighbours[d].x,
+                     from.y + GridNeighbours[d].y};
+  }
+};
+
+enum class PathStatus : uint8_t { Found, NoPath, Invalid };
+
+struct PathResult {
+  uint32_t agent;
+  PathStatus status;
+  PathVector<GridPoint> path;
+  std::shared_ptr<const FlowField> flow_field;
+};
+
+struct PathfindingConfig {
+  int32_t cluster_size = 16;
+  uint32_t flow_field_threshold = 8;
+  uint64_t frame_budget_ns = 2 * SDL_NS_PER_MS;
+};
+
+class PathfindingService : public TrackedObject<MemoryTag::Pathfinding> {
+public:
+  PathfindingService(ThreadPool *pool, TileGrid grid, PathfindingConfig config)
+      : grid(std::move(grid)), config(config), mutex(SDL_CreateMutex()) {
+    clusters_x = (this->grid.width + config.cluster_size - 1) /
+                 config.cluster_size;
+    clusters_y = (this->grid.height + config.cluster_size - 1) /
+                 config.cluster_size;
+    build_abstract_graph(pool);
+  }
+
+  ~PathfindingService() { SDL_DestroyMutex(mutex); }
+
+  // Thread safe. The result arrives as a PathReadyEvent once a later update()
+  // has solved it; fetch it with take_result().
+  uint32_t request_path(uint32_t agent, GridPoint start, GridPoint goal) {
+    SDL_LockMutex(mutex);
+    auto id = next_request++;
+    pending.push_back(PathRequest{id, agent, start, goal});
+    SDL_UnlockMutex(mutex);
+    return id;
+  }
+
+  std::optional<PathResult> take_result(uint32_t request) {
+    SDL_LockMutex(mutex);
+    auto node = results.extract(request);
+    SDL_UnlockMutex(mutex);
+    if (node.empty())
+      return std::nullopt;
+    return std::move(node.mapped());
+  }
+
+  // Solves queued requests across the pool until the frame budget runs out.
+  // Anything left over stays queued, in order, for the next frame.
+  void update(ThreadPool *pool, Dispatcher *dispatcher) {
+    const auto deadline = SDL_GetTicksNS() + config.frame_budget_ns;
+    frame++;
+    deliver(dispatcher);
+
+    PathVector<PathRequest> batch;
+    SDL_LockMutex(mutex);
+    batch.swap(pending);
+    SDL_UnlockMutex(mutex);
+    if (batch.empty())
+      return;
+
+    PathMap<size_t, uint32_t> goal_counts;
+    for (const auto &request : batch) {
+      if (grid.in_bounds(request.goal))
+        goal_counts[grid.index(request.goal)]++;
+    }
+
+    struct Job {
+      size_t request;
+      bool flow_field;
+    };
+    PathVector<Job> jobs;
+    for (const auto &[goal, count] : goal_counts) {
+      if (count >= config.flow_field_threshold &&
+          !flow_fields.contains(goal) && grid.passable(grid.point(goal)))
+        jobs.push_back(Job{goal, true});
+    }
+    // Requests towards a busy or already cached target share its flow field,
+    // the rest get their own HPA* job.
+    constexpr size_t NoJob = std::numeric_limits<size_t>::max();
+    PathVector<size_t> job_of(batch.size(), NoJob);
+    for (size_t i = 0; i < batch.size(); i++) {
+      if (!uses_flow_field(batch[i], goal_counts)) {
+        job_of[i] = jobs.size();
+        jobs.push_back(Job{i, false});
+      }
+    }
+
+    PathVector<PathResult> solved(batch.size());
+    PathVector<std::shared_ptr<const FlowField>> built(jobs.size());
+    PathVector<uint8_t> done(jobs.size(), 0);
+    parallel_for(pool, jobs.size(), [&](size_t i) {
+      // Job 0 always runs so a tiny budget still makes progress.
+      if (i != 0 && SDL_GetTicksNS() >= deadline)
+        return;
+      const auto &job = jobs[i];
+      if (job.flow_field) {
+        built[i] = std::allocate_shared<FlowField>(
+            TrackingAllocator<FlowField, MemoryTag::Pathfinding>{}, grid,
+            grid.point(job.request));
+      } else {
+        const auto &request = batch[job.request];
+        solved[job.request] = find_path(request.start, request.goal);
+        solved[job.request].agent = request.agent;
+      }
+      done[i] = 1;
+    });
+
+    for (size_t i = 0; i < jobs.size(); i++) {
+      if (jobs[i].flow_field && done[i])
+        cache_flow_field(jobs[i].request, std::move(built[i]));
+    }
+
+    PathVector<PathRequest> deferred;
+    PathVector<std::pair<uint32_t, PathResult>> finished;
+    for (size_t i = 0; i < batch.size(); i++) {
+      const auto &request = batch[i];
+      if (job_of[i] == NoJob) {
+        auto cached = flow_fields.find(grid.index(request.goal));
+        if (cached == flow_fields.end()) {
+          deferred.push_back(request);
+          continue;
+        }
+        cached->second.last_used = frame;
+        auto field = cached->second.field;
+        auto status = !grid.passable(request.start) ? PathStatus::Invalid
+                      : field->reachable(grid, request.start)
+                          ? PathStatus::Found
+                          : PathStatus::NoPath;
+        finished.emplace_back(request.id,
+                              PathResult{request.agent, status, {}, field});
+      } else {
+        if (!done[job_of[i]]) {
+          deferred.push_back(request);
+          continue;
+        }
+        finished.emplace_back(request.id, std::move(solved[i]));
+      }
+    }
+
+    SDL_LockMutex(mutex);
+    pending.insert(pending.begin(), deferred.begin(), deferred.end());
+    for (auto &[id, result] : finished) {
+      undelivered.push_back(PathReadyEvent(id, result.agent));
+      results.insert_or_assign(id, std::move(result));
+    }
+    SDL_UnlockMutex(mutex);
+    deliver(dispatcher);
+  }
+
+  // Single HPA* query. Safe to call from any thread.
+  PathResult find_path(GridPoint start, GridPoint goal) const {
+    auto result = PathResult{0, PathStatus::NoPath, {}, nullptr};
+    if (!grid.passable(start) || !grid.passable(goal)) {
+      result.status = PathStatus::Invalid;
+      return result;
+    }
+    if (start == goal) {
+      result.status = PathStatus::Found;
+      return result;
+    }
+
+    const auto start_cluster = cluster_of(start);
+    const auto goal_cluster = cluster_of(goal);
+    if (start_cluster == goal_cluster &&
+        search_rect(grid, cluster_rect(start_cluster), start, goal,
+                    &result.path)) {
+      result.status = PathStatus::Found;
+      return result;
+    }
+
+    auto abstract = search_abstract(start, goal);
+    if (abstract.empty())
+      return result;
+
+    auto current = start;
+    for (auto waypoint : abstract) {
+      auto cluster = cluster_of(current);
+      if (cluster != cluster_of(waypoint)) {
+        // Inter-cluster edges always join two adjacent border tiles.
+        result.path.push_back(waypoint);
+      } else if (waypoint != current &&
+                 !search_rect(grid, cluster_rect(cluster), current, waypoint,
+                              &result.path)) {
+        result.path.clear();
+        return result;
+      }
+      current = waypoint;
+    }
+    smooth_path(start, result.path);
+    result.status = PathStatus::Found;
+    return result;
+  }
+
+  const TileGrid &tiles() const { return grid; }
+
+private:
+  struct PathRequest {
+    uint32_t id;
+    uint32_t agent;
+    GridPoint start;
+    GridPoint goal;
+  };
+
+  struct AbstractEdge {
+    uint32_t to;
+    uint32_t cost;
+  };
+
+  struct CachedFlowField {
+    std::shared_ptr<const FlowField> field;
+    uint64_t last_used;
+  };
+
+  TileGrid grid;
+  PathfindingConfig config;
+  int32_t clusters_x;
+  int32_t clusters_y;
+
+  PathVector<GridPoint> nodes;
+  PathVector<PathVector<AbstractEdge>> edges;
+  PathVector<PathVector<uint32_t>> cluster_nodes;
+  PathMap<size_t, uint32_t> node_at;
+
+  SDL_Mutex *mutex;
+  uint32_t next_request = 0;
+  PathVector<PathRequest> pending;
+  PathMap<uint32_t, PathResult> results;
+  PathVector<PathReadyEvent> undelivered;
+
+  PathMap<size_t, CachedFlowField> flow_fields;
+  uint64_t frame = 0;
+
+  bool uses_flow_field(const PathRequest &request,
+                       const PathMap<size_t, uint32_t> &goal_counts) const {
+    if (!grid.passable(request.goal))
+      return false;
+    auto goal = grid.index(request.goal);
+    if (flow_fields.contains(goal))
+      return true;
+    auto count = goal_counts.find(goal);
+    return count != goal_counts.end() &&
+           count->second >= config.flow_field_threshold;
+  }
+
+  void cache_flow_field(size_t goal, std::shared_ptr<const FlowField> field) {
+    if (flow_fields.size() >= MaxCachedFlowFields) {
+      auto oldest = std::min_element(
+          flow_fields.begin(), flow_fields.end(), [](auto &a, auto &b) {
+            return a.second.last_used < b.second.last_used;
+          });
+      flow_fields.erase(oldest);
+    }
+    flow_fields.insert_or_assign(goal,
+                                 CachedFlowField{std::move(field), frame});
+  }
+
+  // Events that did not fit in the Dispatcher queue are retried next frame.
+  void deliver(Dispatcher *dispatcher) {
+    SDL_LockMutex(mutex);
+    size_t sent = 0;
+    while (sent < undelivered.size() &&
+           dispatcher->queue_event(&undelivered[sent]).has_value())
+      sent++;
+    undelivered.erase(undelivered.begin(), undelivered.begin() + sent);
+    SDL_UnlockMutex(mutex);
+  }
+
+  uint32_t cluster_of(GridPoint p) const {
+    return uint32_t((p.y / config.cluster_size) * clusters_x +
+                    p.x / config.cluster_size);
+  }
+
+  GridRect cluster_rect(uint32_t cluster) const {
+    auto x = int32_t(cluster % clusters_x) * config.cluster_size;
+    auto y = int32_t(cluster / clusters_x) * config.cluster_size;
+    return GridRect{x, y, std::min(config.cluster_size, grid.width - x),
+                    std::min(config.cluster_size, grid.height - y)};
+  }
+
+  uint32_t add_node(GridPoint p) {
+    auto [it, inserted] = node_at.try_emplace(grid.index(p), uint32_t(nodes.size()));
+    if (inserted) {
+      nodes.push_back(p);
+      edges.emplace_back();
+      cluster_nodes[cluster_of(p)].push_back(it->second);
+    }
+    return it->second;
+  }
+
+  // Adds transitions for every run of tiles open on both sides of a cluster
+  // border. Every run gets one in the middle; wide runs also get one at each
+  // end, so paths hugging a wall do not have to cut back to the centre.
+  void add_entrances(GridPoint first, GridPoint step, GridPoint across,
+                     int32_t length) {
+    auto open = [&](int32_t i) {
+      auto a = GridPoint{first.x + step.x * i, first.y + step.y * i};
+      auto b = GridPoint{a.x + across.x, a.y + across.y};
+      return grid.passable(a) && grid.passable(b);
+    };
+    auto connect = [&](int32_t i) {
+      auto a = GridPoint{first.x + step.x * i, first.y + step.y * i};
+      auto b = GridPoint{a.x + across.x, a.y + across.y};
+      auto na = add_node(a);
+      auto nb = add_node(b);
+      edges[na].push_back(AbstractEdge{nb, grid.cost(b)});
+      edges[nb].push_back(AbstractEdge{na, grid.cost(a)});
+    };
+
+    for (int32_t i = 0; i < length;) {
+      if (!open(i)) {
+        i++;
+        continue;
+      }
+      auto run_start = i;
+      while (i < length && open(i))
+        i++;
+      auto run_end = i - 1;
+      connect((run_start + run_end) / 2);
+      if (run_end - run_start + 1 >= MaxEntranceWidth) {
+        connect(run_start);
+        connect(run_end);
+      }
+    }
+  }
+
+  void build_abstract_graph(ThreadPool *pool) {
+    cluster_nodes.resize(size_t(clusters_x) * clusters_y);
+    for (int32_t cy = 0; cy < clusters_y; cy++) {
+      for (int32_t cx = 0; cx < clusters_x; cx++) {
+        auto rect = cluster_rect(uint32_t(cy * clusters_x + cx));
+        if (cx + 1 < clusters_x)
+          add_entrances(GridPoint{rect.x + rect.w - 1, rect.y}, GridPoint{0, 1},
+                        GridPoint{1, 0}, rect.h);
+        if (cy + 1 < clusters_y)
+          add_entrances(GridPoint{rect.x, rect.y + rect.h - 1}, GridPoint{1, 0},
+                        GridPoint{0, 1}, rect.w);
+      }
+    }
+
+    // Intra-cluster edges are independent per cluster, so they are searched
+    // in parallel and merged afterwards.
+    PathVector<PathVector<std::pair<uint32_t, AbstractEdge>>> intra(
+        cluster_nodes.size());
+    parallel_for(pool, cluster_nodes.size(), [&](size_t cluster) {
+      const auto &members = cluster_nodes[cluster];
+      auto rect = cluster_rect(uint32_t(cluster));
+      for (size_t i = 0; i < members.size(); i++) {
+        for (size_t j = i + 1; j < members.size(); j++) {
+          auto a = nodes[members[i]];
+          auto b = nodes[members[j]];
+          auto cost = search_rect(grid, rect, a, b, nullptr);
+          if (!cost)
+            continue;
+          // The reverse walk enters a instead of b.
+          auto back = *cost - grid.cost(b) + grid.cost(a);
+          intra[cluster].emplace_back(members[i],
+                                      AbstractEdge{members[j], *cost});
+          intra[cluster].emplace_back(members[j], AbstractEdge{members[i], back});
+        }
+      }
+    });
+    for (const auto &cluster : intra) {
+      for (const auto &[from, edge] : cluster)
+        edges[from].push_back(edge);
+    }
+  }
+
+  // Refined HPA* paths still detour through transition tiles. Re-solves the
+  // path in stretches of up to two cluster widths, each with A* bounded to
+  // the stretch's bounding box. The box contains the stretch itself, so a
+  // stretch never gets more expensive.
+  void smooth_path(GridPoint start, PathVector<GridPoint> &path) const {
+    const auto window = size_t(SmoothWindowClusters * config.cluster_size);
+    PathVector<GridPoint> smoothed;
+    auto from = start;
+    for (size_t i = 0; i < path.size();) {
+      auto last = std::min(i + window, path.size()) - 1;
+      auto box = GridRect{from.x, from.y, 1, 1};
+      for (auto j = i; j <= last; j++) {
+        auto x0 = std::min(box.x, path[j].x);
+        auto y0 = std::min(box.y, path[j].y);
+        box.w = std::max(box.x + box.w, path[j].x + 1) - x0;
+        box.h = std::max(box.y + box.h, path[j].y + 1) - y0;
+        box.x = x0;
+        box.y = y0;
+      }
+      if (!search_rect(grid, box, from, path[last], &smoothed))
+        smoothed.insert(smoothed.end(), path.begin() + i,
+                        path.begin() + last + 1);
+      from = path[last];
+      i = last + 1;
+    }
+    path = std::move(smoothed);
+  }
+
+  // A* over the abstract graph with start and goal spliced in as two extra
+  // nodes. Returns the waypoints after start, ending with goal.
+  PathVector<GridPoint> search_abstract(GridPoint start, GridPoint goal) const {
+    thread_local SearchScratch scratch;
+    const auto start_node = uint32_t(nodes.size());
+    const auto goal_node = start_node + 1;
+    const auto goal_cluster = cluster_of(goal);
+    auto position = [&](uint32_t node) {
+      return node == start_node  ? start
+             : node == goal_node ? goal
+                                 : nodes[node];
+    };
+
+    PathVector<std::pair<uint32_t, uint32_t>> goal_edges;
+    auto goal_rect = cluster_rect(goal_cluster);
+    for (auto node : cluster_nodes[goal_cluster]) {
+      if (auto cost = search_rect(grid, goal_rect, nodes[node], goal, nullptr))
+        goal_edges.emplace_back(node, *cost);
+    }
+    PathVector<GridPoint> waypoints;
+    if (goal_edges.empty())
+      return waypoints;
+
+    scratch.begin(nodes.size() + 2);
+    scratch.push(start_node, 0, manhattan(start, goal), start_node);
+    auto relax = [&](uint32_t from, uint32_t g, uint32_t to, uint32_t cost) {
+      auto next_g = g + cost;
+      if (scratch.is_closed(to) ||
+          (scratch.visited(to) && scratch.g[to] <= next_g))
+        return;
+      scratch.push(to, next_g, manhattan(position(to), goal), from);
+    };
+
+    while (!scratch.open.empty()) {
+      auto entry = scratch.pop();
+      if (scratch.is_closed(entry.node) || entry.g != scratch.g[entry.node])
+        continue;
+      scratch.closed[entry.node] = scratch.generation;
+
+      if (entry.node == goal_node) {
+        for (auto node = goal_node; node != start_node;
+             node = scratch.parent[node])
+          waypoints.push_back(position(node));
+        std::reverse(waypoints.begin(), waypoints.end());
+        return waypoints;
+      }
+
+      if (entry.node == start_node) {
+        auto start_cluster = cluster_of(start);
+        auto rect = cluster_rect(start_cluster);
+        for (auto node : cluster_nodes[start_cluster]) {
+          if (auto cost = search_rect(grid, rect, start, nodes[node], nullptr))
+            relax(entry.node, entry.g, node, *cost);
+        }
+        continue;
+      }
+
+      for (const auto &edge : edges[entry.node])
+        relax(entry.node, entry.g, edge.to, edge.cost);
+      for (const auto &[node, cost] : goal_edges) {
+        if (node == entry.node)
+          relax(entry.node, entry.g, goal_node, cost);
+      }
+    }
+    return waypoints;
+  }
+};
+} // namespace gatherer
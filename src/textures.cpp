@@ -0,0 +1,388 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <expected>
+#include <new>
+#include <numbers>
+#include <string>
+#include <vector>
+
+#include "SDL3/SDL_error.h"
+#include "SDL3/SDL_pixels.h"
+#include "SDL3/SDL_surface.h"
+#include "gatherer.hpp"
+
+namespace gatherer {
+
+// CPU side of texture loading: converts a decoded surface to tightly packed
+// RGBA8, premultiplies alpha and builds the mip chain. Nothing in here touches
+// the GPU, so an offline cooker can call process_texture() directly and write
+// ProcessedTexture::pixels to an asset pack.
+
+enum class MipFilter : uint8_t { Box, Kaiser };
+
+struct TextureProcessOptions {
+  bool premultiply_alpha = true;
+  bool generate_mips = true;
+  MipFilter filter = MipFilter::Box;
+};
+
+struct MipLevel {
+  uint32_t width;
+  uint32_t height;
+  size_t offset;
+};
+
+template <typename T>
+using TextureVector = std::vector<T, TrackingAllocator<T, MemoryTag::Textures>>;
+
+struct ProcessedTexture {
+  uint32_t width;
+  uint32_t height;
+  TextureVector<MipLevel> levels;
+  TextureVector<uint8_t> pixels;
+};
+
+constexpr size_t TextureBytesPerPixel = 4;
+constexpr uint32_t TextureTileRows = 32;
+
+// Kaiser windowed sinc for a 2:1 reduction. Source texel centres sit at
+// +-0.5, +-1.5 and +-2.5 from the destination texel centre.
+constexpr size_t KaiserTaps = 6;
+constexpr double KaiserAlpha = 4.0;
+constexpr double KaiserRadius = 3.0;
+
+uint32_t mip_level_count(uint32_t width, uint32_t height) {
+  uint32_t levels = 1;
+  for (auto size = std::max(width, height); size > 1; size >>= 1)
+    levels++;
+  return levels;
+}
+
+static uint32_t tile_count(uint32_t rows) {
+  return (rows + TextureTileRows - 1) / TextureTileRows;
+}
+
+// (x * a) / 255 with rounding, exact for all 8 bit inputs and free of
+// divisions so the loop below vectorizes.
+static inline uint8_t mul_div_255(uint32_t x, uint32_t a) {
+  auto t = x * a + 128;
+  return static_cast<uint8_t>((t + (t >> 8)) >> 8);
+}
+
+void premultiply_alpha(uint8_t *pixels, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    auto px = pixels + i * TextureBytesPerPixel;
+    uint32_t a = px[3];
+    px[0] = mul_div_255(px[0], a);
+    px[1] = mul_div_255(px[1], a);
+    px[2] = mul_div_255(px[2], a);
+  }
+}
+
+// Source texels and weights covering one destination texel along one axis.
+// An even size halves into pairs. An odd size 2k + 1 shrinks to k, so every
+// destination texel covers (2k + 1) / k source texels and straddles three of
+// them; the weights are that footprint's overlap with each, in units of
+// 1 / (2k + 1).
+struct BoxTaps {
+  std::array<uint32_t, 3> index;
+  std::array<uint32_t, 3> weight;
+};
+
+static bool box_axis_even(uint32_t src) { return src % 2 == 0 || src == 1; }
+
+static uint32_t box_weight_total(uint32_t src) {
+  return box_axis_even(src) ? 2 : src;
+}
+
+static BoxTaps box_taps(uint32_t src, uint32_t x) {
+  if (box_axis_even(src)) {
+    return BoxTaps{{std::min(2 * x, src - 1), std::min(2 * x + 1, src - 1), 0},
+                   {1, 1, 0}};
+  }
+  auto k = src / 2;
+  return BoxTaps{{2 * x, 2 * x + 1, 2 * x + 2}, {k - x, k, x + 1}};
+}
+
+// Power of two levels take this path. A 1 texel axis is clamped, so it just
+// averages the texel with itself.
+static void downsample_box_even_rows(const uint8_t *src, uint32_t src_w,
+                                     uint32_t src_h, uint8_t *dst,
+                                     uint32_t dst_w, uint32_t y0, uint32_t y1) {
+  const auto src_stride = size_t(src_w) * TextureBytesPerPixel;
+  for (auto y = y0; y < y1; y++) {
+    auto row0 = src + size_t(std::min(2 * y, src_h - 1)) * src_stride;
+    auto row1 = src + size_t(std::min(2 * y + 1, src_h - 1)) * src_stride;
+    auto out = dst + size_t(y) * dst_w * TextureBytesPerPixel;
+    for (uint32_t x = 0; x < dst_w; x++) {
+      auto left = size_t(std::min(2 * x, src_w - 1)) * TextureBytesPerPixel;
+      auto right =
+          size_t(std::min(2 * x + 1, src_w - 1)) * TextureBytesPerPixel;
+      for (size_t c = 0; c < TextureBytesPerPixel; c++) {
+        uint32_t sum = row0[left + c] + row0[right + c] + row1[left + c] +
+                       row1[right + c];
+        out[x * TextureBytesPerPixel + c] = static_cast<uint8_t>((sum + 2) >> 2);
+      }
+    }
+  }
+}
+
+static void downsample_box_rows(const uint8_t *src, uint32_t src_w,
+                                uint32_t src_h, uint8_t *dst, uint32_t dst_w,
+                                uint32_t y0, uint32_t y1) {
+  if (box_axis_even(src_w) && box_axis_even(src_h)) {
+    downsample_box_even_rows(src, src_w, src_h, dst, dst_w, y0, y1);
+    return;
+  }
+
+  const auto src_stride = size_t(src_w) * TextureBytesPerPixel;
+  const auto total =
+      uint64_t(box_weight_total(src_w)) * box_weight_total(src_h);
+  for (auto y = y0; y < y1; y++) {
+    auto ty = box_taps(src_h, y);
+    auto out = dst + size_t(y) * dst_w * TextureBytesPerPixel;
+    for (uint32_t x = 0; x < dst_w; x++) {
+      auto tx = box_taps(src_w, x);
+      for (size_t c = 0; c < TextureBytesPerPixel; c++) {
+        uint64_t sum = 0;
+        for (size_t j = 0; j < 3; j++) {
+          if (ty.weight[j] == 0)
+            continue;
+          auto row = src + size_t(ty.index[j]) * src_stride;
+          for (size_t i = 0; i < 3; i++) {
+            sum += uint64_t(ty.weight[j]) * tx.weight[i] *
+                   row[size_t(tx.index[i]) * TextureBytesPerPixel + c];
+          }
+        }
+        out[x * TextureBytesPerPixel + c] =
+            static_cast<uint8_t>((sum + total / 2) / total);
+      }
+    }
+  }
+}
+
+static double bessel_i0(double x) {
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; k++) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+static const std::array<float, KaiserTaps> &kaiser_weights() {
+  static const auto weights = [] {
+    std::array<float, KaiserTaps> w{};
+    double total = 0.0;
+    for (size_t i = 0; i < KaiserTaps; i++) {
+      auto t = double(i) - (KaiserTaps - 1) / 2.0;
+      auto u = t / 2.0;
+      auto sinc = std::sin(std::numbers::pi * u) / (std::numbers::pi * u);
+      auto r = t / KaiserRadius;
+      auto window = bessel_i0(KaiserAlpha * std::sqrt(1.0 - r * r)) /
+                    bessel_i0(KaiserAlpha);
+      w[i] = static_cast<float>(sinc * window);
+      total += w[i];
+    }
+    for (auto &weight : w)
+      weight = static_cast<float>(weight / total);
+    return w;
+  }();
+  return weights;
+}
+
+static inline uint32_t clamp_index(int64_t i, uint32_t size) {
+  return static_cast<uint32_t>(std::clamp<int64_t>(i, 0, int64_t(size) - 1));
+}
+
+// Horizontal half of the separable Kaiser filter: src_h rows of src_w texels
+// become src_h rows of dst_w float texels.
+static void kaiser_horizontal_rows(const uint8_t *src, uint32_t src_w,
+                                   float *tmp, uint32_t dst_w, uint32_t y0,
+                                   uint32_t y1) {
+  const auto &w = kaiser_weights();
+  const auto first = -int64_t(KaiserTaps / 2 - 1);
+  for (auto y = y0; y < y1; y++) {
+    auto in = src + size_t(y) * src_w * TextureBytesPerPixel;
+    auto out = tmp + size_t(y) * dst_w * TextureBytesPerPixel;
+    for (uint32_t x = 0; x < dst_w; x++) {
+      float acc[TextureBytesPerPixel] = {};
+      for (size_t t = 0; t < KaiserTaps; t++) {
+        auto sx = clamp_index(2 * int64_t(x) + first + int64_t(t), src_w);
+        auto texel = in + size_t(sx) * TextureBytesPerPixel;
+        for (size_t c = 0; c < TextureBytesPerPixel; c++)
+          acc[c] += w[t] * texel[c];
+      }
+      for (size_t c = 0; c < TextureBytesPerPixel; c++)
+        out[x * TextureBytesPerPixel + c] = acc[c];
+    }
+  }
+}
+
+// Vertical half of the Kaiser filter. The negative lobes can overshoot, so
+// for premultiplied input each colour channel is clamped to the texel's alpha
+// to keep the result valid premultiplied data.
+static void kaiser_vertical_rows(const float *tmp, uint32_t src_h,
+                                 uint8_t *dst, uint32_t dst_w,
+                                 bool premultiplied, uint32_t y0,
+                                 uint32_t y1) {
+  const auto &w = kaiser_weights();
+  const auto first = -int64_t(KaiserTaps / 2 - 1);
+  const auto stride = size_t(dst_w) * TextureBytesPerPixel;
+  for (auto y = y0; y < y1; y++) {
+    auto out = dst + size_t(y) * stride;
+    for (uint32_t x = 0; x < dst_w; x++) {
+      auto i = size_t(x) * TextureBytesPerPixel;
+      float acc[TextureBytesPerPixel] = {};
+      for (size_t t = 0; t < KaiserTaps; t++) {
+        auto sy = clamp_index(2 * int64_t(y) + first + int64_t(t), src_h);
+        auto texel = tmp + size_t(sy) * stride + i;
+        for (size_t c = 0; c < TextureBytesPerPixel; c++)
+          acc[c] += w[t] * texel[c];
+      }
+      auto alpha = std::clamp(acc[3] + 0.5f, 0.0f, 255.0f);
+      auto limit = premultiplied ? alpha : 255.0f;
+      for (size_t c = 0; c < 3; c++)
+        out[i + c] =
+            static_cast<uint8_t>(std::clamp(acc[c] + 0.5f, 0.0f, limit));
+      out[i + 3] = static_cast<uint8_t>(alpha);
+    }
+  }
+}
+
+static void generate_mip(ThreadPool *pool, MipFilter filter,
+                         bool premultiplied, const uint8_t *src, uint32_t src_w,
+                         uint32_t src_h, uint8_t *dst, uint32_t dst_w,
+                         uint32_t dst_h) {
+  switch (filter) {
+  case MipFilter::Box: {
+    parallel_for(pool, tile_count(dst_h), [&](size_t tile) {
+      auto y0 = uint32_t(tile) * TextureTileRows;
+      auto y1 = std::min(y0 + TextureTileRows, dst_h);
+      downsample_box_rows(src, src_w, src_h, dst, dst_w, y0, y1);
+    });
+    break;
+  }
+  case MipFilter::Kaiser: {
+    TextureVector<float> tmp(size_t(dst_w) * src_h * TextureBytesPerPixel);
+    parallel_for(pool, tile_count(src_h), [&](size_t tile) {
+      auto y0 = uint32_t(tile) * TextureTileRows;
+      auto y1 = std::min(y0 + TextureTileRows, src_h);
+      kaiser_horizontal_rows(src, src_w, tmp.data(), dst_w, y0, y1);
+    });
+    parallel_for(pool, tile_count(dst_h), [&](size_t tile) {
+      auto y0 = uint32_t(tile) * TextureTileRows;
+      auto y1 = std::min(y0 + TextureTileRows, dst_h);
+      kaiser_vertical_rows(tmp.data(), src_h, dst, dst_w, premultiplied, y0,
+                           y1);
+    });
+    break;
+  }
+  }
+}
+
+// Converts any non-indexed surface format to RGBA8 with SDL's SIMD blitters,
+// one tile of rows per task. Also drops the surface pitch padding.
+static std::expected<void, std::string> convert_to_rgba8(ThreadPool *pool,
+                                                         SDL_Surface *surface,
+                                                         uint8_t *dst) {
+  if (SDL_ISPIXELFORMAT_INDEXED(surface->format)) {
+    auto converted = SDL_ConvertSurface(surface, SDL_PIXELFORMAT_RGBA32);
+    if (converted == nullptr)
+      return std::unexpected(std::string(SDL_GetError()));
+    auto result = convert_to_rgba8(pool, converted, dst);
+    SDL_DestroySurface(converted);
+    return result;
+  }
+
+  if (SDL_MUSTLOCK(surface) && !SDL_LockSurface(surface))
+    return std::unexpected(std::string(SDL_GetError()));
+
+  const auto width = uint32_t(surface->w);
+  const auto height = uint32_t(surface->h);
+  const auto dst_pitch = int(width * TextureBytesPerPixel);
+  // SDL errors are per thread, so the failing tile records its own message.
+  std::atomic<bool> failed = false;
+  std::string error;
+  parallel_for(pool, tile_count(height), [&](size_t tile) {
+    auto y0 = uint32_t(tile) * TextureTileRows;
+    auto rows = std::min(TextureTileRows, height - y0);
+    auto src = static_cast<const uint8_t *>(surface->pixels) +
+               size_t(y0) * surface->pitch;
+    if (!SDL_ConvertPixels(int(width), int(rows), surface->format, src,
+                           surface->pitch, SDL_PIXELFORMAT_RGBA32,
+                           dst + size_t(y0) * dst_pitch, dst_pitch) &&
+        !failed.exchange(true, std::memory_order_relaxed)) {
+      error = SDL_GetError();
+    }
+  });
+
+  if (SDL_MUSTLOCK(surface))
+    SDL_UnlockSurface(surface);
+  if (failed.load(std::memory_order_relaxed))
+    return std::unexpected(error);
+  return std::expected<void, std::string>{};
+}
+
+static std::expected<ProcessedTexture, std::string>
+build_texture(ThreadPool *pool, SDL_Surface *surface,
+              const TextureProcessOptions &options) {
+  auto texture = ProcessedTexture{};
+  texture.width = uint32_t(surface->w);
+  texture.height = uint32_t(surface->h);
+
+  auto num_levels =
+      options.generate_mips ? mip_level_count(texture.width, texture.height) : 1;
+  size_t total = 0;
+  for (uint32_t i = 0, w = texture.width, h = texture.height; i < num_levels;
+       i++, w = std::max(w / 2, 1u), h = std::max(h / 2, 1u)) {
+    texture.levels.push_back(MipLevel{w, h, total});
+    total += size_t(w) * h * TextureBytesPerPixel;
+  }
+  texture.pixels.resize(total);
+
+  auto result = convert_to_rgba8(pool, surface, texture.pixels.data());
+  if (!result.has_value())
+    return std::unexpected(result.error());
+
+  // Premultiply before filtering so transparent texels do not bleed their
+  // colour into the smaller levels.
+  if (options.premultiply_alpha) {
+    const auto pixel_count = size_t(texture.width) * texture.height;
+    parallel_for(pool, tile_count(texture.height), [&](size_t tile) {
+      auto first = tile * TextureTileRows * texture.width;
+      auto count =
+          std::min(size_t(TextureTileRows) * texture.width, pixel_count - first);
+      premultiply_alpha(texture.pixels.data() + first * TextureBytesPerPixel,
+                        count);
+    });
+  }
+
+  for (size_t i = 1; i < texture.levels.size(); i++) {
+    const auto &src = texture.levels[i - 1];
+    const auto &dst = texture.levels[i];
+    generate_mip(pool, options.filter, options.premultiply_alpha,
+                 texture.pixels.data() + src.offset, src.width, src.height,
+                 texture.pixels.data() + dst.offset, dst.width, dst.height);
+  }
+
+  return texture;
+}
+
+std::expected<ProcessedTexture, std::string>
+process_texture(ThreadPool *pool, SDL_Surface *surface,
+                const TextureProcessOptions &options) {
+  if (surface == nullptr || surface->w <= 0 || surface->h <= 0)
+    return std::unexpected("Invalid surface");
+  // Every textures allocation happens on this thread, outside the parallel
+  // tiles, so a "fail" budget is reported here as an error.
+  try {
+    return build_texture(pool, surface, options);
+  } catch (const std::bad_alloc &) {
+    return std::unexpected("Texture memory budget exceeded");
+  }
+}
+} // namespace gatherer
@@ -0,0 +1,324 @@
+// CPU-only tests for the pathfinding service. Every HPA* answer is checked
+// against a plain Dijkstra over the whole grid, and update() is driven with a
+// real Dispatcher to cover batching, flow fields and deferral.
+
+#include <SDL3/SDL_init.h>
+#include <cstdio>
+#include <cstring>
+#include <queue>
+#include <vector>
+
+#include "memory.cpp"
+#include "async.cpp"
+#include "events.cpp"
+#include "pathfinding.cpp"
+
+using namespace gatherer;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,    \
+                   #cond);                                                     \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+// Deterministic so a failure reproduces.
+struct Random {
+  uint32_t state;
+  uint32_t next(uint32_t bound) {
+    state = state * 1664525 + 1013904223;
+    return (state >> 8) % bound;
+  }
+};
+
+// Reference cost from start to every tile, PathUnreachable where none.
+static std::vector<uint32_t> dijkstra(const TileGrid &grid, GridPoint start) {
+  std::vector<uint32_t> dist(grid.costs.size(), PathUnreachable);
+  std::priority_queue<std::pair<uint32_t, size_t>,
+                      std::vector<std::pair<uint32_t, size_t>>, std::greater<>>
+      open;
+  dist[grid.index(start)] = 0;
+  open.emplace(0, grid.index(start));
+  while (!open.empty()) {
+    auto [d, index] = open.top();
+    open.pop();
+    if (d != dist[index])
+      continue;
+    auto p = grid.point(index);
+    for (auto step : GridNeighbours) {
+      auto next = GridPoint{p.x + step.x, p.y + step.y};
+      if (!grid.passable(next))
+        continue;
+      auto cost = d + grid.cost(next);
+      if (cost < dist[grid.index(next)]) {
+        dist[grid.index(next)] = cost;
+        open.emplace(cost, grid.index(next));
+      }
+    }
+  }
+  return dist;
+}
+
+// Cost of walking path from start, or PathUnreachable if any step is not to
+// a passable 4-neighbour or the path does not end at goal.
+static uint32_t walk_cost(const TileGrid &grid, GridPoint start,
+                          GridPoint goal, const PathVector<GridPoint> &path) {
+  uint32_t cost = 0;
+  auto current = start;
+  for (auto p : path) {
+    if (manhattan(current, p) != 1 || !grid.passable(p))
+      return PathUnreachable;
+    cost += grid.cost(p);
+    current = p;
+  }
+  return current == goal ? cost : PathUnreachable;
+}
+
+// HPA* is not exact, but a refined and smoothed path should stay close to
+// optimal instead of detouring to transitions at cluster corners.
+static bool near_optimal(uint64_t cost, uint64_t optimal) {
+  return cost >= optimal && cost * 4 <= optimal * 5 + 8;
+}
+
+static TileGrid random_grid(Random &random, int32_t width, int32_t height,
+                            uint32_t blocked_percent) {
+  auto grid = TileGrid(width, height);
+  for (auto &cost : grid.costs) {
+    cost = random.next(100) < blocked_percent
+               ? 0
+               : static_cast<uint8_t>(1 + random.next(3));
+  }
+  return grid;
+}
+
+static void test_open_grid() {
+  auto service = PathfindingService(nullptr, TileGrid(128, 128),
+                                    PathfindingConfig{});
+  // Crossing one cluster border on an open grid must not detour to a
+  // transition at the cluster corner.
+  auto result = service.find_path({8, 8}, {24, 8});
+  CHECK(result.status == PathStatus::Found);
+  CHECK(result.path.size() == 16);
+
+  Random random{7};
+  uint64_t found_cost = 0;
+  uint64_t optimal_cost = 0;
+  for (int i = 0; i < 200; i++) {
+    auto start =
+        GridPoint{int32_t(random.next(128)), int32_t(random.next(128))};
+    auto goal = GridPoint{int32_t(random.next(128)), int32_t(random.next(128))};
+    result = service.find_path(start, goal);
+    CHECK(result.status == PathStatus::Found);
+    auto cost = walk_cost(service.tiles(), start, goal, result.path);
+    CHECK(near_optimal(cost, manhattan(start, goal)));
+    found_cost += cost;
+    optimal_cost += manhattan(start, goal);
+  }
+  CHECK(found_cost * 100 <= optimal_cost * 101);
+}
+
+// Random obstacles and tile costs, with a world size that leaves partial
+// clusters on the right and bottom edges.
+static void test_random_grids() {
+  Random random{12345};
+  uint64_t found_cost = 0;
+  uint64_t optimal_cost = 0;
+  for (int round = 0; round < 12; round++) {
+    auto config = PathfindingConfig{};
+    config.cluster_size = 6 + int32_t(random.next(10));
+    auto grid = random_grid(random, 61, 47, 10 + random.next(25));
+    auto service = PathfindingService(nullptr, grid, config);
+
+    for (int query = 0; query < 40; query++) {
+      auto start =
+          GridPoint{int32_t(random.next(61)), int32_t(random.next(47))};
+      auto goal = GridPoint{int32_t(random.next(61)), int32_t(random.next(47))};
+      auto result = service.find_path(start, goal);
+      if (!grid.passable(start) || !grid.passable(goal)) {
+        CHECK(result.status == PathStatus::Invalid);
+        continue;
+      }
+      auto optimal = dijkstra(grid, start)[grid.index(goal)];
+      if (optimal == PathUnreachable) {
+        CHECK(result.status == PathStatus::NoPath);
+        CHECK(result.path.empty());
+        continue;
+      }
+      CHECK(result.status == PathStatus::Found);
+      auto cost = walk_cost(grid, start, goal, result.path);
+      CHECK(cost != PathUnreachable);
+      if (cost == PathUnreachable)
+        continue;
+      CHECK(near_optimal(cost, optimal));
+      found_cost += cost;
+      optimal_cost += optimal;
+    }
+  }
+  CHECK(found_cost * 100 <= optimal_cost * 103);
+}
+
+struct Delivered {
+  PathfindingService *service;
+  std::vector<uint32_t> requests;
+  std::vector<PathResult> results;
+};
+
+static void on_path_ready(void *raw, void *context) {
+  auto event = static_cast<PathReadyEvent *>(raw);
+  auto delivered = static_cast<Delivered *>(context);
+  delivered->requests.push_back(event->request);
+  auto result = delivered->service->take_result(event->request);
+  CHECK(result.has_value());
+  CHECK(result.has_value() && result->agent == event->agent);
+  if (result.has_value())
+    delivered->results.push_back(std::move(*result));
+}
+
+// Requests towards a busy target share one flow field, the rest get HPA*
+// paths, and every result arrives exactly once through the Dispatcher.
+static void test_batching(ThreadPool *pool) {
+  Random random{99};
+  auto grid = random_grid(random, 64, 64, 15);
+  const auto target = GridPoint{40, 40};
+  grid.costs[grid.index(target)] = 1;
+  auto config = PathfindingConfig{};
+  config.flow_field_threshold = 4;
+  config.frame_budget_ns = 1000 * SDL_NS_PER_MS;
+  auto service = PathfindingService(pool, grid, config);
+  auto dispatcher = new Dispatcher;
+  auto delivered = Delivered{&service, {}, {}};
+  CHECK(dispatcher
+            ->subscribe(EventType::PathReadyEvent, on_path_ready, &delivered)
+            .has_value());
+
+  std::vector<GridPoint> starts;
+  for (uint32_t agent = 0; agent < 12; agent++) {
+    auto start = GridPoint{int32_t(random.next(64)), int32_t(random.next(64))};
+    auto goal = agent < 6 ? target : GridPoint{int32_t(random.next(64)),
+                                               int32_t(random.next(64))};
+    starts.push_back(start);
+    service.request_path(agent, start, goal);
+  }
+  service.update(pool, dispatcher);
+  dispatcher->update();
+  CHECK(delivered.results.size() == 12);
+
+  for (const auto &result : delivered.results) {
+    if (result.agent >= 6) {
+      CHECK(result.flow_field == nullptr);
+      continue;
+    }
+    const auto start = starts[result.agent];
+    CHECK(result.flow_field != nullptr);
+    if (result.flow_field == nullptr)
+      continue;
+    if (!grid.passable(start)) {
+      CHECK(result.status == PathStatus::Invalid);
+      continue;
+    }
+    // Flow fields are exact: following them costs the Dijkstra distance.
+    auto optimal = dijkstra(grid, start)[grid.index(target)];
+    auto reachable = optimal != PathUnreachable;
+    CHECK(result.status ==
+          (reachable ? PathStatus::Found : PathStatus::NoPath));
+    if (!reachable)
+      continue;
+    uint32_t cost = 0;
+    auto current = start;
+    while (auto next = result.flow_field->next(grid, current)) {
+      CHECK(grid.passable(*next));
+      cost += grid.cost(*next);
+      current = *next;
+    }
+    CHECK(current == target);
+    CHECK(cost == optimal);
+  }
+
+  // A second wave to the same target reuses the cached field even below the
+  // threshold.
+  service.request_path(20, {0, 0}, target);
+  service.update(pool, dispatcher);
+  dispatcher->update();
+  CHECK(delivered.results.size() == 13);
+  if (delivered.results.size() == 13)
+    CHECK(delivered.results.back().flow_field != nullptr);
+  delete dispatcher;
+}
+
+// With no frame budget only the first job of each update runs. The rest stay
+// queued in order, ahead of anything requested later.
+static void test_deferral() {
+  auto config = PathfindingConfig{};
+  config.frame_budget_ns = 0;
+  auto service = PathfindingService(nullptr, TileGrid(32, 32), config);
+  auto dispatcher = new Dispatcher;
+  auto delivered = Delivered{&service, {}, {}};
+  CHECK(dispatcher
+            ->subscribe(EventType::PathReadyEvent, on_path_ready, &delivered)
+            .has_value());
+
+  std::vector<uint32_t> ids;
+  for (uint32_t agent = 0; agent < 4; agent++)
+    ids.push_back(service.request_path(agent, {0, int32_t(agent)}, {31, 31}));
+  service.update(nullptr, dispatcher);
+  dispatcher->update();
+  CHECK(delivered.requests.size() == 1);
+
+  ids.push_back(service.request_path(4, {5, 5}, {6, 6}));
+  for (int frame = 0; frame < 8 && delivered.requests.size() < ids.size();
+       frame++) {
+    service.update(nullptr, dispatcher);
+    dispatcher->update();
+  }
+  CHECK(delivered.requests == ids);
+  for (const auto &result : delivered.results)
+    CHECK(result.status == PathStatus::Found);
+  delete dispatcher;
+}
+
+// More results than the Dispatcher queue holds are delivered over later
+// updates instead of being dropped.
+static void test_full_dispatcher() {
+  auto config = PathfindingConfig{};
+  config.frame_budget_ns = 1000 * SDL_NS_PER_MS;
+  auto service = PathfindingService(nullptr, TileGrid(32, 32), config);
+  auto dispatcher = new Dispatcher;
+  auto delivered = Delivered{&service, {}, {}};
+  CHECK(dispatcher
+            ->subscribe(EventType::PathReadyEvent, on_path_ready, &delivered)
+            .has_value());
+
+  const uint32_t count = MaxQueued + 100;
+  for (uint32_t agent = 0; agent < count; agent++)
+    service.request_path(agent, {int32_t(agent % 32), 0}, {16, 16});
+  service.update(nullptr, dispatcher);
+  dispatcher->update();
+  CHECK(delivered.requests.size() < count);
+  service.update(nullptr, dispatcher);
+  dispatcher->update();
+  CHECK(delivered.requests.size() == count);
+  delete dispatcher;
+}
+
+int main(int, char **) {
+  // Pool workers are detached, so the pool is kept alive until exit.
+  auto pool = new ThreadPool(3);
+
+  test_open_grid();
+  test_random_grids();
+  test_batching(nullptr);
+  test_batching(pool);
+  test_deferral();
+  test_full_dispatcher();
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d pathfinding checks failed\n", failures);
+    return 1;
+  }
+  std::printf("pathfinding tests passed\n");
+  return 0;
+}
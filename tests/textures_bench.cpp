@@ -0,0 +1,78 @@
+// Times process_texture() on the CPU, once single threaded and once on a pool
+// with a worker per spare core. Usage: textures_bench [size] [iterations]
+
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_pixels.h>
+#include <SDL3/SDL_surface.h>
+#include <SDL3/SDL_timer.h>
+#include <cstdio>
+#include <cstdlib>
+
+#include "memory.cpp"
+#include "async.cpp"
+#include "textures.cpp"
+
+using namespace gatherer;
+
+static void run(const char *label, ThreadPool *pool, SDL_Surface *surface,
+                const TextureProcessOptions &options, int iterations) {
+  double best = 0.0;
+  double total = 0.0;
+  for (int i = 0; i < iterations; i++) {
+    auto start = SDL_GetPerformanceCounter();
+    auto texture = process_texture(pool, surface, options);
+    auto elapsed = double(SDL_GetPerformanceCounter() - start) * 1000.0 /
+                   double(SDL_GetPerformanceFrequency());
+    if (!texture.has_value()) {
+      std::fprintf(stderr, "process_texture failed: %s\n",
+                   texture.error().c_str());
+      std::exit(1);
+    }
+    best = i == 0 ? elapsed : std::min(best, elapsed);
+    total += elapsed;
+  }
+  std::printf("%-24s best %8.3f ms  mean %8.3f ms\n", label, best,
+              total / iterations);
+}
+
+int main(int argc, char **argv) {
+  const int size = argc > 1 ? std::atoi(argv[1]) : 2048;
+  const int iterations = argc > 2 ? std::atoi(argv[2]) : 10;
+  if (size <= 0 || iterations <= 0) {
+    std::fprintf(stderr, "usage: %s [size] [iterations]\n", argv[0]);
+    return 1;
+  }
+
+  // BGRA source so the conversion path does real swizzling.
+  auto surface = SDL_CreateSurface(size, size, SDL_PIXELFORMAT_BGRA32);
+  uint32_t state = 0x12345678;
+  for (int y = 0; y < size; y++) {
+    auto row = static_cast<uint8_t *>(surface->pixels) + y * surface->pitch;
+    for (int x = 0; x < size * 4; x++) {
+      state = state * 1664525 + 1013904223;
+      row[x] = uint8_t(state >> 24);
+    }
+  }
+
+  // The calling thread works too, so N - 1 workers keep N cores busy.
+  const auto workers =
+      size_t(std::max(SDL_GetNumLogicalCPUCores() - 1, 1));
+  // Pool workers are detached, so the pool is kept alive until exit.
+  auto pool = new ThreadPool(workers);
+
+  std::printf("%dx%d RGBA, %d iterations, %zu workers + caller\n", size, size,
+              iterations, workers);
+  for (auto filter : {MipFilter::Box, MipFilter::Kaiser}) {
+    auto options = TextureProcessOptions{};
+    options.filter = filter;
+    const char *name = filter == MipFilter::Box ? "box" : "kaiser";
+    char label[64];
+    std::snprintf(label, sizeof(label), "%s, pool 0", name);
+    run(label, nullptr, surface, options, iterations);
+    std::snprintf(label, sizeof(label), "%s, pool %zu", name, workers);
+    run(label, pool, surface, options, iterations);
+  }
+
+  SDL_DestroySurface(surface);
+  return 0;
+}
@@ -0,0 +1,322 @@
+// CPU-only tests for the texture processing stage. Built as its own unity
+// translation unit like main.cpp, so it needs SDL for surfaces and threads but
+// never creates a window or a GPU device.
+
+#include <SDL3/SDL_init.h>
+#include <SDL3/SDL_pixels.h>
+#include <SDL3/SDL_surface.h>
+#include <cstdio>
+#include <cstring>
+
+#include "memory.cpp"
+#include "async.cpp"
+#include "textures.cpp"
+
+using namespace gatherer;
+
+static int failures = 0;
+
+#define CHECK(cond)                                                            \
+  do {                                                                         \
+    if (!(cond)) {                                                             \
+      std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__,    \
+                   #cond);                                                     \
+      failures++;                                                              \
+    }                                                                          \
+  } while (0)
+
+static SDL_Surface *make_rgba(int width, int height,
+                              void (*fill)(int x, int y, uint8_t *px)) {
+  auto surface = SDL_CreateSurface(width, height, SDL_PIXELFORMAT_RGBA32);
+  for (int y = 0; y < height; y++) {
+    auto row = static_cast<uint8_t *>(surface->pixels) + y * surface->pitch;
+    for (int x = 0; x < width; x++)
+      fill(x, y, row + x * 4);
+  }
+  return surface;
+}
+
+static const uint8_t *texel(const ProcessedTexture &texture, size_t level,
+                            uint32_t x, uint32_t y) {
+  const auto &mip = texture.levels[level];
+  return texture.pixels.data() + mip.offset +
+         (size_t(y) * mip.width + x) * TextureBytesPerPixel;
+}
+
+static void test_mul_div_255() {
+  for (uint32_t x = 0; x < 256; x++) {
+    for (uint32_t a = 0; a < 256; a++) {
+      if (mul_div_255(x, a) != (x * a + 127) / 255) {
+        std::fprintf(stderr, "mul_div_255(%u, %u) = %u, expected %u\n", x, a,
+                     mul_div_255(x, a), (x * a + 127) / 255);
+        failures++;
+        return;
+      }
+    }
+  }
+}
+
+static void test_premultiply_alpha() {
+  uint8_t pixels[] = {255, 128, 0,   128, // half transparent
+                      200, 100, 50,  0,   // fully transparent
+                      12,  34,  56,  255, // opaque
+                      255, 255, 255, 1,   // nearly transparent
+                      9,   9,   9,   9};  // past count, must be untouched
+  premultiply_alpha(pixels, 4);
+  const uint8_t expected[] = {128, 64, 0,  128, 0, 0, 0, 0, 12, 34,
+                              56,  255, 1, 1,   1, 1, 9, 9, 9,  9};
+  CHECK(std::memcmp(pixels, expected, sizeof(expected)) == 0);
+}
+
+static void test_mip_layout() {
+  CHECK(mip_level_count(1, 1) == 1);
+  CHECK(mip_level_count(2, 1) == 2);
+  CHECK(mip_level_count(256, 256) == 9);
+  CHECK(mip_level_count(300, 20) == 9);
+  CHECK(mip_level_count(1, 7) == 3);
+  CHECK(mip_level_count(5, 3) == 3);
+
+  auto surface = make_rgba(5, 3, [](int, int, uint8_t *px) {
+    std::memset(px, 255, 4);
+  });
+  auto texture = process_texture(nullptr, surface, TextureProcessOptions{});
+  SDL_DestroySurface(surface);
+  CHECK(texture.has_value());
+  if (!texture.has_value())
+    return;
+
+  CHECK(texture->width == 5 && texture->height == 3);
+  CHECK(texture->levels.size() == 3);
+  if (texture->levels.size() != 3)
+    return;
+  const MipLevel expected[] = {{5, 3, 0}, {2, 1, 60}, {1, 1, 68}};
+  for (size_t i = 0; i < 3; i++) {
+    CHECK(texture->levels[i].width == expected[i].width);
+    CHECK(texture->levels[i].height == expected[i].height);
+    CHECK(texture->levels[i].offset == expected[i].offset);
+  }
+  CHECK(texture->pixels.size() == 72);
+}
+
+static void test_box_filter() {
+  // A black and white checkerboard averages to mid grey at every level.
+  auto surface = make_rgba(4, 2, [](int x, int y, uint8_t *px) {
+    uint8_t v = (x + y) % 2 == 0 ? 0 : 255;
+    px[0] = px[1] = px[2] = v;
+    px[3] = 255;
+  });
+  auto options = TextureProcessOptions{};
+  options.premultiply_alpha = false;
+  auto texture = process_texture(nullptr, surface, options);
+  SDL_DestroySurface(surface);
+  CHECK(texture.has_value() && texture->levels.size() == 3);
+  if (!texture.has_value() || texture->levels.size() != 3)
+    return;
+  for (uint32_t x = 0; x < 2; x++) {
+    auto px = texel(*texture, 1, x, 0);
+    CHECK(px[0] == 128 && px[1] == 128 && px[2] == 128 && px[3] == 255);
+  }
+  auto px = texel(*texture, 2, 0, 0);
+  CHECK(px[0] == 128 && px[3] == 255);
+
+  // Odd sizes filter over the whole source footprint, so 3 -> 1 averages all
+  // three texels instead of dropping the last one.
+  surface = make_rgba(3, 1, [](int x, int, uint8_t *px) {
+    px[0] = uint8_t(x * 100);
+    px[1] = px[2] = 0;
+    px[3] = 255;
+  });
+  texture = process_texture(nullptr, surface, options);
+  SDL_DestroySurface(surface);
+  CHECK(texture.has_value() && texture->levels.size() == 2);
+  if (texture.has_value() && texture->levels.size() == 2)
+    CHECK(texel(*texture, 1, 0, 0)[0] == 100);
+
+  // 5 -> 2 weights the shared middle texel half to each side: (2, 2, 1) / 5
+  // and (1, 2, 2) / 5. Rows are odd too, 3 -> 1, with equal weights.
+  surface = make_rgba(5, 3, [](int x, int y, uint8_t *px) {
+    px[0] = uint8_t(x * 50);
+    px[1] = uint8_t(y * 90);
+    px[2] = 0;
+    px[3] = 255;
+  });
+  texture = process_texture(nullptr, surface, options);
+  SDL_DestroySurface(surface);
+  CHECK(texture.has_value() && texture->levels.size() == 3);
+  if (!texture.has_value() || texture->levels.size() != 3)
+    return;
+  auto left = texel(*texture, 1, 0, 0);
+  auto right = texel(*texture, 1, 1, 0);
+  CHECK(left[0] == 40 && left[1] == 90 && left[3] == 255);
+  CHECK(right[0] == 160 && right[1] == 90 && right[3] == 255);
+  CHECK(texel(*texture, 2, 0, 0)[0] == 100);
+}
+
+static void test_kaiser_filter() {
+  // The weights are normalised, so a flat colour survives every level.
+  auto surface = make_rgba(16, 12, [](int, int, uint8_t *px) {
+    px[0] = 10;
+    px[1] = 20;
+    px[2] = 30;
+    px[3] = 255;
+  });
+  auto options = TextureProcessOptions{};
+  options.premultiply_alpha = false;
+  options.filter = MipFilter::Kaiser;
+  auto texture = process_texture(nullptr, surface, options);
+  SDL_DestroySurface(surface);
+  CHECK(texture.has_value());
+  if (!texture.has_value())
+    return;
+  for (size_t level = 1; level < texture->levels.size(); level++) {
+    const auto &mip = texture->levels[level];
+    for (uint32_t y = 0; y < mip.height; y++) {
+      for (uint32_t x = 0; x < mip.width; x++) {
+        auto px = texel(*texture, level, x, y);
+        CHECK(px[0] == 10 && px[1] == 20 && px[2] == 30 && px[3] == 255);
+      }
+    }
+  }
+
+  // Hard colour edges under constant alpha make the negative lobes overshoot
+  // past alpha. Premultiplied output must still never have a colour channel
+  // above alpha.
+  surface = make_rgba(32, 32, [](int x, int y, uint8_t *px) {
+    bool lit = x % 6 >= 1 && x % 6 <= 4 && y % 6 >= 1 && y % 6 <= 4;
+    uint8_t v = lit ? 255 : 0;
+    px[0] = px[1] = v;
+    px[2] = 255;
+    px[3] = 128;
+  });
+  options.premultiply_alpha = true;
+  texture = process_texture(nullptr, surface, options);
+  SDL_DestroySurface(surface);
+  CHECK(texture.has_value());
+  if (!texture.has_value())
+    return;
+  size_t invalid = 0;
+  for (size_t level = 0; level < texture->levels.size(); level++) {
+    const auto &mip = texture->levels[level];
+    for (uint32_t y = 0; y < mip.height; y++) {
+      for (uint32_t x = 0; x < mip.width; x++) {
+        auto px = texel(*texture, level, x, y);
+        if (px[0] > px[3] || px[1] > px[3] || px[2] > px[3])
+          invalid++;
+      }
+    }
+  }
+  CHECK(invalid == 0);
+}
+
+static void test_padded_pitch(ThreadPool *pool) {
+  // BGRA rows with 12 bytes of padding, tall enough to span several tiles.
+  const int width = 7;
+  const int height = 70;
+  const int pitch = width * 4 + 12;
+  std::vector<uint8_t> source(size_t(pitch) * height, 0xAB);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      auto px = source.data() + y * pitch + x * 4;
+      px[0] = uint8_t(x);     // B
+      px[1] = uint8_t(y);     // G
+      px[2] = uint8_t(x + y); // R
+      px[3] = 255;
+    }
+  }
+  auto surface = SDL_CreateSurfaceFrom(width, height, SDL_PIXELFORMAT_BGRA32,
+                                       source.data(), pitch);
+  auto options = TextureProcessOptions{};
+  options.premultiply_alpha = false;
+  options.generate_mips = false;
+  auto texture = process_texture(pool, surface, options);
+  SDL_DestroySurface(surface);
+  CHECK(texture.has_value());
+  if (!texture.has_value())
+    return;
+  CHECK(texture->levels.size() == 1);
+  CHECK(texture->pixels.size() == size_t(width) * height * 4);
+  size_t mismatched = 0;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      auto px = texel(*texture, 0, x, y);
+      if (px[0] != uint8_t(x + y) || px[1] != uint8_t(y) ||
+          px[2] != uint8_t(x) || px[3] != 255)
+        mismatched++;
+    }
+  }
+  CHECK(mismatched == 0);
+}
+
+static void test_indexed_surface(ThreadPool *pool) {
+  const SDL_Color colors[] = {
+      {255, 0, 0, 255}, {0, 255, 0, 128}, {0, 0, 255, 0}, {10, 20, 30, 40}};
+  auto surface = SDL_CreateSurface(6, 40, SDL_PIXELFORMAT_INDEX8);
+  auto palette = SDL_CreateSurfacePalette(surface);
+  SDL_SetPaletteColors(palette, colors, 0, 4);
+  for (int y = 0; y < surface->h; y++) {
+    auto row = static_cast<uint8_t *>(surface->pixels) + y * surface->pitch;
+    for (int x = 0; x < surface->w; x++)
+      row[x] = uint8_t((x + y) % 4);
+  }
+  auto options = TextureProcessOptions{};
+  options.premultiply_alpha = false;
+  options.generate_mips = false;
+  auto texture = process_texture(pool, surface, options);
+  SDL_DestroySurface(surface);
+  CHECK(texture.has_value());
+  if (!texture.has_value())
+    return;
+  size_t mismatched = 0;
+  for (uint32_t y = 0; y < texture->height; y++) {
+    for (uint32_t x = 0; x < texture->width; x++) {
+      auto px = texel(*texture, 0, x, y);
+      const auto &c = colors[(x + y) % 4];
+      if (px[0] != c.r || px[1] != c.g || px[2] != c.b || px[3] != c.a)
+        mismatched++;
+    }
+  }
+  CHECK(mismatched == 0);
+}
+
+// Tiles run on the pool must produce exactly what a single thread does.
+static void test_pool_matches_inline(ThreadPool *pool) {
+  for (auto filter : {MipFilter::Box, MipFilter::Kaiser}) {
+    auto surface = make_rgba(100, 75, [](int x, int y, uint8_t *px) {
+      px[0] = uint8_t(x * 7 + y);
+      px[1] = uint8_t(x ^ y);
+      px[2] = uint8_t(y * 3);
+      px[3] = uint8_t(x * y);
+    });
+    auto options = TextureProcessOptions{};
+    options.filter = filter;
+    auto inline_result = process_texture(nullptr, surface, options);
+    auto pooled_result = process_texture(pool, surface, options);
+    SDL_DestroySurface(surface);
+    CHECK(inline_result.has_value() && pooled_result.has_value());
+    if (inline_result.has_value() && pooled_result.has_value())
+      CHECK(inline_result->pixels == pooled_result->pixels);
+  }
+}
+
+int main(int, char **) {
+  // Pool workers are detached, so the pool is kept alive until exit.
+  auto pool = new ThreadPool(3);
+
+  test_mul_div_255();
+  test_premultiply_alpha();
+  test_mip_layout();
+  test_box_filter();
+  test_kaiser_filter();
+  test_padded_pitch(nullptr);
+  test_padded_pitch(pool);
+  test_indexed_surface(nullptr);
+  test_indexed_surface(pool);
+  test_pool_matches_inline(pool);
+
+  if (failures != 0) {
+    std::fprintf(stderr, "%d texture checks failed\n", failures);
+    return 1;
+  }
+  std::printf("texture tests passed\n");
+  return 0;
+}